@@ -0,0 +1,14 @@
+#pragma once
+
+// Makes the compiler assume the value is used (and the memory it points to is read and written),
+// so the computation of a result which is only timed can't be optimized away.
+template <class T>
+inline void do_not_optimize(const T& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
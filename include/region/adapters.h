@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+#include "region/allocator.h"
+
+namespace region {
+
+// Standard allocator allocating from a region::Allocator, for using std containers in a region:
+//
+//     region::Allocator region;
+//     std::vector<int, region::StdAllocator<int>> v(region::StdAllocator<int>(region));
+//
+// deallocate() does nothing, the memory is released with the region.
+template <class T>
+class StdAllocator
+{
+    template <class U>
+    friend class StdAllocator;
+
+    Allocator* region;
+
+public:
+    using value_type = T;
+
+    explicit StdAllocator(Allocator& region) : region(&region) {}
+    template <class U>
+    StdAllocator(const StdAllocator<U>& other) : region(other.region)
+    {}
+
+    T* allocate(size_t n) { return (T*)region->allocate_block(n * sizeof(T), alignof(T)); }
+    void deallocate(T*, size_t) {}
+
+    template <class U>
+    bool operator==(const StdAllocator<U>& other) const
+    {
+        return region == other.region;
+    }
+    template <class U>
+    bool operator!=(const StdAllocator<U>& other) const
+    {
+        return region != other.region;
+    }
+};
+
+// std::pmr::memory_resource allocating from a region::Allocator, for the std::pmr containers.
+// do_deallocate() does nothing, the memory is released with the region.
+class MemoryResource : public std::pmr::memory_resource
+{
+    Allocator* region;
+
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        return region->allocate_block(bytes, alignment);
+    }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+public:
+    explicit MemoryResource(Allocator& region) : region(&region) {}
+};
+
+}  // namespace region
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "region/file_arena.h"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace region {
+
+const int MAX_SMALL_BLOCK_SIZE = 4096;
+const int PAGE_SIZE = 65536;
+const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+// Tuning parameters of the region allocator.
+struct Params
+{
+    using time_point = std::chrono::high_resolution_clock::time_point;
+
+    size_t page_size = PAGE_SIZE;
+    // Bigger blocks get a heap allocation of their own instead of being carved from a page. Must
+    // not be more than page_size.
+    size_t max_small_block_size = MAX_SMALL_BLOCK_SIZE;
+    // If set, called after each heap (or file) allocation of the allocator, a new page or a large
+    // block, with the number of bytes and the time the allocation started.
+    void (*on_heap_allocation)(bool large_block, size_t bytes, time_point start) = nullptr;
+    // If set, the pages and large blocks are mapped from a temporary file in this directory
+    // instead of allocated from the heap (see FileArena), so the region can be bigger than the RAM.
+    const char* file_directory = nullptr;
+    // If set, the pages from the heap are aligned to HUGE_PAGE_SIZE and (on Linux) the kernel is
+    // asked to back them with transparent huge pages, which pays off if page_size is a multiple
+    // of HUGE_PAGE_SIZE. Each page costs HUGE_PAGE_SIZE more heap for the alignment.
+    bool huge_pages = false;
+
+    bool valid() const { return 0 < max_small_block_size && max_small_block_size <= page_size; }
+};
+
+// Region-style allocator which allocates small blocks from bigger pages and release everything only
+// at a single point, when it goes out of scope.
+class Allocator
+{
+    const Params params;
+    std::vector<std::unique_ptr<char[]>> pages;
+    std::vector<std::unique_ptr<char[]>> large_blocks;
+    std::unique_ptr<FileArena> file_arena;
+    size_t page_count = 0, large_block_count = 0;
+    void* active_page_first_free_byte = nullptr;
+    size_t active_page_bytes_left = 0;
+
+    // A page or a large block, from the heap or the file.
+    char* allocate_chunk(size_t size, std::vector<std::unique_ptr<char[]>>& chunks)
+    {
+        if (file_arena) {
+            return (char*)file_arena->allocate(size);
+        }
+        if (params.huge_pages && &chunks == &pages) {
+            chunks.emplace_back(new char[size + HUGE_PAGE_SIZE]);
+            uintptr_t p = (uintptr_t)chunks.back().get();
+            char* page = (char*)((p + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+            madvise(page, size, MADV_HUGEPAGE);  // Only a hint, failing is fine.
+#endif
+            return page;
+        }
+        chunks.emplace_back(new char[size]);
+        return chunks.back().get();
+    }
+
+    Params::time_point now() const
+    {
+        return params.on_heap_allocation ? std::chrono::high_resolution_clock::now()
+                                         : Params::time_point();
+    }
+
+    void* allocate_large_block(size_t size, size_t alignment)
+    {
+        auto t0 = now();
+        size_t space = size + alignment - 1;
+        void* p = allocate_chunk(space, large_blocks);
+        ++large_block_count;
+        if (params.on_heap_allocation)
+            params.on_heap_allocation(true, space, t0);
+        return std::align(alignment, size, p, space);
+    }
+
+public:
+    explicit Allocator(const Params& params = Params())
+        : params(params),
+          file_arena(params.file_directory ? std::make_unique<FileArena>(params.file_directory)
+                                           : nullptr)
+    {
+        assert(params.valid());
+    }
+    ~Allocator() = default;  // All the pages and large blocks are released here.
+
+    void* allocate_block(size_t size, size_t alignment)
+    {
+        // Blocks which might not fit into an empty page because of the alignment are large, too.
+        if (size <= params.max_small_block_size && size + alignment <= params.page_size) {
+            if (!active_page_first_free_byte) {
+                // Need a new page.
+                auto t0 = now();
+                active_page_first_free_byte = allocate_chunk(params.page_size, pages);
+                ++page_count;
+                active_page_bytes_left = params.page_size;
+                if (params.on_heap_allocation)
+                    params.on_heap_allocation(false, params.page_size, t0);
+            }
+            if (std::align(alignment, size, active_page_first_free_byte, active_page_bytes_left)) {
+                // Allocate from active page.
+                auto result = active_page_first_free_byte;
+                active_page_first_free_byte = (char*)active_page_first_free_byte + size;
+                active_page_bytes_left -= size;
+                return result;
+            } else {
+                // No room in active page, inactivate and retry.
+                active_page_first_free_byte = nullptr;
+                active_page_bytes_left = 0;
+                return allocate_block(size, alignment);
+            }
+        }
+        return allocate_large_block(size, alignment);
+    }
+
+    // Allocate and placement-new.
+    template <class T, class... Args>
+    T* new_object(Args&&... args)
+    {
+        void* p = allocate_block(sizeof(T), alignof(T));
+        return new (p) T(std::forward<Args>(args)...);
+    }
+
+    // Allocate an array of n objects of trivial type T, uninitialized.
+    template <class T>
+    T* new_array(size_t n)
+    {
+        static_assert(std::is_trivial<T>::value, "new_array() doesn't construct the objects");
+        return (T*)allocate_block(n * sizeof(T), alignof(T));
+    }
+
+    const Params& get_params() const { return params; }
+    size_t n_pages() const { return page_count; }
+    size_t n_large_blocks() const { return large_block_count; }
+};
+
+}  // namespace region
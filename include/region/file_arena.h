@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace region {
+
+// Memory mapped from a temporary (already unlinked) file, so the kernel can write it out and read
+// it back when it doesn't fit into RAM. Blocks are carved from segments of SEGMENT_SIZE, bigger
+// blocks get a segment of their own. Everything is unmapped when the arena is destroyed.
+class FileArena
+{
+    int fd = -1;
+    size_t file_size = 0;
+    std::vector<std::pair<char*, size_t>> segments;
+    char* next = nullptr;
+    size_t bytes_left = 0;
+
+public:
+    static constexpr size_t SEGMENT_SIZE = size_t(1) << 30;
+    static constexpr size_t ALIGNMENT = 64;
+
+#if defined(__unix__) || defined(__APPLE__)
+    // Creates the file in directory, throws std::system_error if that's not possible.
+    explicit FileArena(const char* directory)
+    {
+        std::string path = std::string(directory) + "/region-XXXXXX";
+        fd = mkstemp(&path[0]);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), path);
+        }
+        unlink(path.c_str());
+    }
+    ~FileArena()
+    {
+        for (auto& s : segments) {
+            munmap(s.first, s.second);
+        }
+        close(fd);
+    }
+
+    // Returns a block aligned to ALIGNMENT, throws std::bad_alloc if the file can't grow.
+    void* allocate(size_t size)
+    {
+        size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        if (size > bytes_left) {
+            size_t segment_size = std::max(size, SEGMENT_SIZE);
+            if (ftruncate(fd, file_size + segment_size) != 0) {
+                throw std::bad_alloc();
+            }
+            void* p = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                           file_size);
+            if (p == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            file_size += segment_size;
+            segments.emplace_back((char*)p, segment_size);
+            next = (char*)p;
+            bytes_left = segment_size;
+        }
+        void* result = next;
+        next += size;
+        bytes_left -= size;
+        return result;
+    }
+#else
+    explicit FileArena(const char*)
+    {
+        throw std::system_error(std::make_error_code(std::errc::function_not_supported));
+    }
+    void* allocate(size_t) { throw std::bad_alloc(); }
+#endif
+    FileArena(const FileArena&) = delete;
+    FileArena& operator=(const FileArena&) = delete;
+
+    size_t mapped_bytes() const { return file_size; }
+};
+
+}  // namespace region
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cassert>
+#include <new>
+
+#include "region/allocator.h"
+
+namespace region {
+
+// Round-up sizeof(T) to alignment.
+template <class T>
+struct aligned_item_size
+{
+    static constexpr int value = ((sizeof(T) + alignof(T) - 1) / alignof(T)) * alignof(T);
+};
+
+// Vector which allocates fixed memory in constructor, from the region-style allocator (and no
+// deallocation).
+template <class T>
+class Vector
+{
+    T* const items;
+    int size = 0;
+    const int max_size;
+
+public:
+    Vector(Allocator& a, int max_size)
+        : items((T*)(a.allocate_block(max_size * aligned_item_size<T>::value, alignof(T)))),
+          max_size(max_size)
+    {}
+
+    // Placement-new and increase size.
+    void push_back(const T& x)
+    {
+        assert(size < max_size);
+        new (&(items[size++])) T(x);
+    }
+    T* begin() { return items; }
+    T* end() { return items + size; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + size; }
+};
+
+}  // namespace region
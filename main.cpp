@@ -1,11 +1,39 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <climits>
+#include <cmath>
 #include <cstddef>
-#include <deque>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
 #include <vector>
 
-using std::deque;
+#include "do_not_optimize.h"
+#include "perf_counters.h"
+#include "region/allocator.h"
+#include "region/vector.h"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
 using std::make_unique;
 using std::unique_ptr;
 using std::vector;
@@ -13,257 +41,3683 @@ using std::vector;
 const int N_CHILDREN = 3;  // Each non-leaf node has this many children.
 const int TREE_DEPTH = 15;
 
+// The malloc implementation behind the global operator new. The benchmark-<malloc> targets link
+// another one and define MALLOC_NAME.
+#if defined(MALLOC_NAME)
+const char* const MALLOC = MALLOC_NAME;
+#elif defined(__GLIBC__)
+const char* const MALLOC = "glibc";
+#else
+const char* const MALLOC = "system";
+#endif
+
+// The build variant, the PGO targets define BUILD_NAME (see BENCHMARK_PGO in CMakeLists.txt).
+#if defined(BUILD_NAME)
+const char* const BUILD = BUILD_NAME;
+#else
+const char* const BUILD = "default";
+#endif
+
+// Node ids and node and allocation counts. The benchmark-scale target defines SCALE64 for trees
+// of more than INT_MAX nodes, by default the nodes stay as small as they are.
+#if defined(SCALE64)
+using Count = long long;
+#else
+using Count = int;
+#endif
+const long long MAX_NODES = std::numeric_limits<Count>::max();
+
+using hrclock = std::chrono::high_resolution_clock;
+using ddur = std::chrono::duration<double>;
+using time_point = hrclock::time_point;
+using duration = hrclock::duration;
+
+// Milliseconds, as printed by the modes which compare strategies in a table.
+double ms(duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// Size of the heap block at p as seen by the malloc implementation, 0 if the platform can't tell.
+size_t heap_block_size(void* p)
+{
+#if defined(__GLIBC__)
+    return malloc_usable_size(p);
+#elif defined(__APPLE__)
+    return malloc_size(p);
+#else
+    (void)p;
+    return 0;
+#endif
+}
+
+// Resident set size of the process in bytes, -1 if not available.
+long long resident_set_size()
+{
+    long long rss = -1;
+#if defined(__linux__)
+    if (FILE* f = fopen("/proc/self/statm", "r")) {
+        long long size_pages, resident_pages;
+        if (fscanf(f, "%lld %lld", &size_pages, &resident_pages) == 2)
+            rss = resident_pages * sysconf(_SC_PAGESIZE);
+        fclose(f);
+    }
+#endif
+    return rss;
+}
+
+// Index of the calling thread within a parallel build, 0 on the main thread. Used as the thread id
+// of the trace events.
+thread_local int g_thread_index = 0;
+
+// Writes a trace in the Chrome trace-event format (load it in chrome://tracing or
+// https://ui.perfetto.dev). Events are streamed to the file through stdio as they happen, so
+// tracing never calls operator new and doesn't show up in the allocation statistics. Thread-safe.
+class Trace
+{
+    FILE* file = nullptr;
+    std::mutex mutex;
+    bool first_event = true;
+    time_point start;
+    std::atomic<duration::rep> last_sample{0};  // Time of the last counter sample, since start.
+    // Heap bytes allocated and not yet freed since the trace was opened.
+    std::atomic<long long> live_bytes{0};
+    std::atomic<int> n_heap_events{0};
+
+    double us(time_point t) const
+    {
+        return std::chrono::duration<double, std::micro>(t - start).count();
+    }
+    void begin_event()
+    {
+        fprintf(file, first_event ? "\n" : ",\n");
+        first_event = false;
+    }
+
+public:
+    bool enabled() const { return file != nullptr; }
+
+    bool open(const char* path)
+    {
+        file = fopen(path, "w");
+        if (!file)
+            return false;
+        fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        first_event = true;
+        start = hrclock::now();
+        last_sample = 0;
+        live_bytes = 0;
+        thread_name(0, "main");
+        return true;
+    }
+    void close()
+    {
+        if (!file)
+            return;
+        fprintf(file, "\n]}\n");
+        fclose(file);
+        file = nullptr;
+    }
+
+    void thread_name(int tid, const char* name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        begin_event();
+        fprintf(file,
+                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}",
+                tid, name);
+    }
+
+    // A complete ("X") event: a span on the timeline of the calling thread, with an optional
+    // numeric argument.
+    void span(const char* name,
+              const char* category,
+              time_point begin,
+              time_point end,
+              const char* arg_name = nullptr,
+              double arg_value = 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        begin_event();
+        fprintf(file,
+                "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                "\"pid\":1,\"tid\":%d",
+                name, category, us(begin), us(end) - us(begin), g_thread_index);
+        if (arg_name)
+            fprintf(file, ",\"args\":{\"%s\":%.0f}", arg_name, arg_value);
+        fprintf(file, "}");
+    }
+
+    // A sample on the counter track called name.
+    void counter(const char* name, time_point t, double value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        begin_event();
+        fprintf(file,
+                "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,"
+                "\"args\":{\"bytes\":%.0f}}",
+                name, us(t), value);
+    }
+
+    // Emits the live heap bytes and the RSS counters.
+    void sample_counters()
+    {
+        auto now = hrclock::now();
+        last_sample = (now - start).count();
+        counter("live heap", now, live_bytes);
+        long long rss = resident_set_size();
+        if (rss >= 0)
+            counter("RSS", now, rss);
+    }
+
+    // Called by operator new/delete. Samples the counters at most once per millisecond.
+    void on_heap_change(long long delta)
+    {
+        live_bytes += delta;
+        if (++n_heap_events % 1024 == 0 &&
+            hrclock::now() - start - duration(last_sample) >= std::chrono::milliseconds(1))
+            sample_counters();
+    }
+};
+
+Trace g_trace;
+
 // Global new and delete operators redefined to logging versions.
 
 struct AllocationStat
 {
-    int n_nodes_created = 0;
+    Count n_nodes_created = 0;
     size_t total_bytes_allocated = 0;
-    int n_allocations = 0;
-    int n_frees = 0;
+    Count n_allocations = 0;
+    Count n_frees = 0;
 };
 
-AllocationStat g_stat;
+// Per-thread, merged into the main thread's statistics after a parallel build.
+thread_local AllocationStat g_stat;
 
 void* operator new(size_t size)
 {
     ++g_stat.n_allocations;
     g_stat.total_bytes_allocated += size;
     void* p = malloc(size);
+    if (g_trace.enabled())
+        g_trace.on_heap_change(heap_block_size(p));
     return p;
 }
 
 void operator delete(void* p) noexcept
 {
     ++g_stat.n_frees;
+    if (g_trace.enabled() && p)
+        g_trace.on_heap_change(-(long long)heap_block_size(p));
     free(p);
 }
 
+// The over-aligned versions are used by std::pmr::new_delete_resource().
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    ++g_stat.n_allocations;
+    g_stat.total_bytes_allocated += size;
+    size_t a = static_cast<size_t>(alignment);
+    void* p = aligned_alloc(a, (size + a - 1) / a * a);
+    if (g_trace.enabled())
+        g_trace.on_heap_change(heap_block_size(p));
+    return p;
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    operator delete(p);
+}
+
+// Mixes value into the hash (as boost::hash_combine), the order of the values matters.
+uint64_t hash_combine(uint64_t hash, uint64_t value)
+{
+    return hash ^ (value * 0x9e3779b97f4a7c15 + 0x7f4a7c159e3779b9 + (hash << 6) + (hash >> 2));
+}
+
+// Base of the nodes which cache the checksum and a structural hash of their subtree (see
+// update_checksum()). A node is dirty if it or any of its descendants changed since they were
+// computed, so the ancestors of a dirty node are dirty, too.
+template <class Node>
+struct ChecksumCache
+{
+    Node* parent = nullptr;
+    int subtree_checksum = 0;
+    uint64_t subtree_hash = 0;  // Of the node ids and the shape, unlike the checksum.
+    bool dirty = true;
+};
+
+// Base of the nodes which don't cache the checksum, empty.
+struct NoChecksumCache
+{};
+
+template <class Node, bool CacheChecksum>
+using ChecksumCacheBase = std::conditional_t<CacheChecksum, ChecksumCache<Node>, NoChecksumCache>;
+
 namespace with_raii {
 
 // Allocator is not used in this implementation. It's here only to ensure this Node has the same API
 // as the other implementation.
 struct Allocator
-{};
+{
+    template <class Params>
+    explicit Allocator(const Params&)
+    {}
+};
 
-// Standard, RAII-style tree node.
-struct Node
+// Standard, RAII-style tree node, optionally caching its subtree checksum.
+template <bool CacheChecksum>
+struct BasicNode : ChecksumCacheBase<BasicNode<CacheChecksum>, CacheChecksum>
 {
-    vector<unique_ptr<Node>> children;
-    const int node_id = g_stat.n_nodes_created++;
+    vector<unique_ptr<BasicNode>> children;
+    Count node_id = g_stat.n_nodes_created++;
 
-    Node(Allocator&, int max_n_children) { children.reserve(max_n_children); }
+    BasicNode(Allocator&, int max_n_children) { children.reserve(max_n_children); }
+    BasicNode(BasicNode&& other)
+        : ChecksumCacheBase<BasicNode, CacheChecksum>(other),
+          children(std::move(other.children)),
+          node_id(other.node_id)
+    {
+        if constexpr (CacheChecksum) {
+            for (auto& c : children) {
+                c->parent = this;
+            }
+        }
+    }
     void add_child(Allocator& a, int max_n_children)
     {
-        children.push_back(make_unique<Node>(a, max_n_children));
+        children.push_back(make_unique<BasicNode>(a, max_n_children));
+        if constexpr (CacheChecksum) {
+            children.back()->parent = this;
+        }
     }
 };
 
+using Node = BasicNode<false>;
+
 }  // namespace with_raii
 
 namespace without_raii {
 
-const int MAX_SMALL_BLOCK_SIZE = 4096;
-const int PAGE_SIZE = 65536;
+using region::Allocator;
+using region::Vector;
 
-// Region-style allocator which allocates small blocks from bigger pages and release everything only
-// at a single point, when it goes out of scope.
-class Allocator
+// Node, which stores its region-allocated children in the region-allocated Vector, optionally
+// caching its subtree checksum.
+template <bool CacheChecksum>
+struct BasicNode : ChecksumCacheBase<BasicNode<CacheChecksum>, CacheChecksum>
 {
-    using Page = std::aligned_storage<PAGE_SIZE, 1024>::type;
-    deque<Page> pages;
-    void* active_page_first_free_byte = nullptr;
-    size_t active_page_bytes_left = 0;
-
-public:
-    ~Allocator() = default;  // All the pages are released here.
+    Vector<BasicNode*> children;
+    Count node_id = g_stat.n_nodes_created++;
 
-    void* allocate_block(size_t size, size_t alignment)
+    BasicNode(Allocator& a, int max_n_children) : children(a, max_n_children) {}
+    // Moving the root (build_tree() returns it by value) updates the parents of the children.
+    BasicNode(BasicNode&& other)
+        : ChecksumCacheBase<BasicNode, CacheChecksum>(other),
+          children(other.children),
+          node_id(other.node_id)
     {
-        if (size <= MAX_SMALL_BLOCK_SIZE) {
-            if (!active_page_first_free_byte) {
-                // Need a new page.
-                pages.emplace_back();
-                active_page_first_free_byte = &pages.back();
-                active_page_bytes_left = PAGE_SIZE;
-            }
-            if (std::align(alignment, size, active_page_first_free_byte, active_page_bytes_left)) {
-                // Allocate from active page.
-                auto result = active_page_first_free_byte;
-                active_page_first_free_byte = (char*)active_page_first_free_byte + size;
-                active_page_bytes_left -= size;
-                return result;
-            } else {
-                // No room in active page, inactivate and retry.
-                active_page_first_free_byte = nullptr;
-                active_page_bytes_left = 0;
-                return allocate_block(size, alignment);
+        if constexpr (CacheChecksum) {
+            for (auto c : children) {
+                c->parent = this;
             }
         }
-        fprintf(stderr, "Allocating more then %d is not implemented.\n", MAX_SMALL_BLOCK_SIZE);
-        std::terminate();
+    }
+    void add_child(Allocator& a, int max_n_children)
+    {
+        BasicNode* new_node = a.new_object<BasicNode>(a, max_n_children);
+        if constexpr (CacheChecksum) {
+            new_node->parent = this;
+        }
+        children.push_back(new_node);
+    }
+};
+
+using Node = BasicNode<false>;
+}  // namespace without_raii
+
+namespace with_pmr {
+
+// Owns a std::pmr memory resource, which allocates from the global operator new.
+template <class Resource>
+struct Allocator
+{
+    Resource resource;
+
+    template <class Params>
+    explicit Allocator(const Params&)
+    {}
+};
+
+// RAII-style tree node, like with_raii::Node, but the node and its children vector are allocated
+// from the memory resource of the allocator passed to the constructor or add_child(). (That's the
+// resource of the children vector, too, which is used to free the node.)
+struct Node
+{
+    std::pmr::vector<Node*> children;
+    const Count node_id = g_stat.n_nodes_created++;
+
+    Node(std::pmr::memory_resource* resource, int max_n_children) : children(resource)
+    {
+        children.reserve(max_n_children);
+    }
+    template <class Allocator>
+    Node(Allocator& a, int max_n_children) : Node(&a.resource, max_n_children)
+    {}
+    Node(Node&&) = default;
+    ~Node()
+    {
+        for (Node* c : children) {
+            std::pmr::polymorphic_allocator<Node> a = c->children.get_allocator();
+            c->~Node();
+            a.deallocate(c, 1);
+        }
     }
 
-    // Allocate and placement-new.
-    template <class T, class... Args>
-    T* new_object(Args&&... args)
+    template <class Allocator>
+    void add_child(Allocator& a, int max_n_children)
     {
-        void* p = allocate_block(sizeof(T), alignof(T));
-        return new (p) T(std::forward<Args>(args)...);
+        std::pmr::polymorphic_allocator<Node> node_allocator(&a.resource);
+        children.push_back(new (node_allocator.allocate(1)) Node(a, max_n_children));
     }
 };
 
-// Round-up sizeof(T) to alignment.
-template <class T>
-struct aligned_item_size
+}  // namespace with_pmr
+
+namespace soa {
+
+// Structure-of-arrays tree: node i has node_id[i], first_child[i] and n_children[i], each field in
+// an array of its own, allocated from the region. The nodes are numbered level by level, so the
+// children of a node are consecutive. Built by build_tree<region::Allocator, soa::Tree>().
+struct Tree
+{
+    Count n_nodes = 0;
+    Count* node_id = nullptr;
+    Count* first_child = nullptr;
+    int* n_children = nullptr;
+
+    template <class Allocator>
+    Tree(Allocator& a, Count n_nodes)
+        : n_nodes(n_nodes),
+          node_id(a.template new_array<Count>(n_nodes)),
+          first_child(a.template new_array<Count>(n_nodes)),
+          n_children(a.template new_array<int>(n_nodes))
+    {}
+};
+
+}  // namespace soa
+
+namespace with_payload {
+
+// Fields of a node which the traversal doesn't need: where it was defined and its name.
+struct ColdFields
 {
-    static constexpr int value = ((sizeof(T) + alignof(T) - 1) / alignof(T)) * alignof(T);
+    int file, line, column;
+    char name[20];
 };
 
-// Vector which allocates fixed memory in constructor, from the region-style allocator (and no
-// deallocation).
-template <class T>
-class Vector
+ColdFields make_cold_fields(Count node_id)
+{
+    ColdFields c{int(node_id % 97), int(node_id / 97), int(node_id % 80), {}};
+    snprintf(c.name, sizeof(c.name), "node%lld", (long long)node_id);
+    return c;
+}
+
+// Append-only array of ColdFields in a region of its own, in chunks of CHUNK_SIZE.
+class ColdStream
 {
-    T* const items;
+    static const int CHUNK_SIZE = 1024;
+    region::Allocator region;
+    vector<ColdFields*> chunks;
     int size = 0;
-    const int max_size;
 
 public:
-    Vector(Allocator& a, int max_size)
-        : items((T*)(a.allocate_block(max_size * aligned_item_size<T>::value, alignof(T)))),
-          max_size(max_size)
-    {}
+    explicit ColdStream(const region::Params& params) : region(params) {}
 
-    // Placement-new and increase size.
-    void push_back(const T& x)
+    // Returns the new item, which stays where it is.
+    const ColdFields* push_back(const ColdFields& x)
     {
-        assert(size < max_size);
-        new (&(items[size++])) T(x);
+        if (size % CHUNK_SIZE == 0) {
+            chunks.push_back(region.new_array<ColdFields>(CHUNK_SIZE));
+        }
+        ColdFields* item = &chunks.back()[size++ % CHUNK_SIZE];
+        *item = x;
+        return item;
     }
-    const T* begin() const { return items; }
-    const T* end() const { return items + size; }
 };
 
-// Node, which stores its region-allocated children in the region-allocated Vector.
+// Region allocator with a ColdStream for the nodes it allocates.
+struct Allocator : region::Allocator
+{
+    ColdStream cold_stream;
+
+    explicit Allocator(const region::Params& params)
+        : region::Allocator(params), cold_stream(params)
+    {}
+};
+
+// Region tree node with a payload of cold fields. With SplitCold, the cold fields are moved to the
+// cold stream of the allocator, the node points to them, so the nodes are smaller and the
+// traversal touches fewer cache lines. Each build thread has an allocator of its own, so the
+// cold fields of a tree are in several streams.
+template <bool SplitCold>
 struct Node
 {
-    Vector<Node*> children;
-    const int node_id = g_stat.n_nodes_created++;
+    region::Vector<Node*> children;
+    const Count node_id = g_stat.n_nodes_created++;
+    // The fields in the cold stream of the allocator of the node, or the fields themselves.
+    std::conditional_t<SplitCold, const ColdFields*, ColdFields> cold;
 
-    Node(Allocator& a, int max_n_children) : children(a, max_n_children) {}
+    Node(Allocator& a, int max_n_children) : children(a, max_n_children), cold(make_cold(a))
+    {}
+    const ColdFields& cold_fields() const
+    {
+        if constexpr (SplitCold) {
+            return *cold;
+        } else {
+            return cold;
+        }
+    }
     void add_child(Allocator& a, int max_n_children)
     {
-        Node* new_node = a.new_object<Node>(a, max_n_children);
-        children.push_back(new_node);
+        children.push_back(a.new_object<Node>(a, max_n_children));
+    }
+
+private:
+    decltype(cold) make_cold(Allocator& a) const
+    {
+        if constexpr (SplitCold) {
+            return a.cold_stream.push_back(make_cold_fields(node_id));
+        } else {
+            return make_cold_fields(node_id);
+        }
     }
 };
-}  // namespace without_raii
 
-// Build a tree TREE_DEPTH levels deep, each node having N_CHILDREN children.
-template <class Allocator, class Node>
-void build_subtree(Allocator& allocator, Node& node, int levels_left)
+}  // namespace with_payload
+
+namespace dag {
+
+// Node of a hash-consed tree: structurally identical subtrees are stored only once, so the tree
+// becomes a DAG. The node ids are not stored (they would make every subtree different), the
+// traversal reconstructs them from the position of the node, in the order build_subtree() would
+// have assigned them, so the checksum is the same as that of the tree.
+struct Node
 {
-    for (int i = 0; i < N_CHILDREN; ++i)
-        node.add_child(allocator, N_CHILDREN);
-    if (--levels_left <= 0) {
-        return;
+    region::Vector<Node*> children;
+    Count n_descendants;  // In the tree, counting each occurrence of shared subtrees.
+    uint64_t hash;      // Of the children pointers, which are unique for each shape.
+
+    Node(region::Allocator& a, int n_children) : children(a, n_children) {}
+};
+
+// Builds the DAG bottom-up, looking up each new node in a hash table of the existing ones. The
+// table (open addressing) is allocated from the region, too, the old one is abandoned when it
+// grows.
+class Builder
+{
+    region::Allocator& allocator;
+    size_t capacity = 1024, size = 0;
+    Node** table;
+    vector<Node*> children;  // The children of the nodes being built, as a stack.
+
+public:
+    explicit Builder(region::Allocator& allocator)
+        : allocator(allocator), table(new_table(capacity))
+    {}
+
+    // Returns the node with the given children (the last n_children of the stack), creating it if
+    // there's none yet, and pops them.
+    Node* get(int n_children)
+    {
+        Node* const* first = children.data() + children.size() - n_children;
+        uint64_t hash = n_children;
+        for (int i = 0; i < n_children; ++i) {
+            hash = hash_combine(hash, (uintptr_t)first[i]);
+        }
+        size_t slot = hash & (capacity - 1);
+        for (; table[slot]; slot = (slot + 1) & (capacity - 1)) {
+            Node* node = table[slot];
+            if (node->hash == hash && node->children.end() - node->children.begin() == n_children &&
+                std::equal(first, first + n_children, node->children.begin())) {
+                children.resize(children.size() - n_children);
+                return node;
+            }
+        }
+        Node* node = allocator.new_object<Node>(allocator, n_children);
+        node->n_descendants = 0;
+        node->hash = hash;
+        for (int i = 0; i < n_children; ++i) {
+            node->children.push_back(first[i]);
+            node->n_descendants += 1 + first[i]->n_descendants;
+        }
+        children.resize(children.size() - n_children);
+        table[slot] = node;
+        if (++size * 2 > capacity) {
+            grow();
+        }
+        return node;
     }
-    for (auto& c : node.children) {
-        build_subtree(allocator, *c, levels_left);
+
+    // Builds a subtree levels_left levels deep (see build_subtree()).
+    Node* build(int levels_left, int n_children)
+    {
+        g_stat.n_nodes_created += n_children;
+        for (int i = 0; i < n_children; ++i) {
+            children.push_back(levels_left > 1 ? build(levels_left - 1, n_children) : get(0));
+        }
+        return get(n_children);
     }
-}
 
-template <class Allocator, class Node>
-Node build_tree(Allocator& allocator)
-{
-    Node root(allocator, N_CHILDREN);
-    build_subtree(allocator, root, TREE_DEPTH);
-    return root;
-}
+private:
+    Node** new_table(size_t n)
+    {
+        Node** t = allocator.new_array<Node*>(n);
+        std::fill(t, t + n, nullptr);
+        return t;
+    }
+    void grow()
+    {
+        Node** old = table;
+        size_t old_capacity = capacity;
+        capacity *= 2;
+        table = new_table(capacity);
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (Node* node = old[i]) {
+                size_t slot = node->hash & (capacity - 1);
+                while (table[slot]) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                table[slot] = node;
+            }
+        }
+    }
+};
 
-// Traverse the tree (depth-first), calculate checksum.
-template <class Node>
-int traverse(const Node& node)
+}  // namespace dag
+
+namespace succinct {
+
+// Bits in the region with rank and select support. rank_samples[b] is the number of ones before
+// block b of BLOCK_WORDS words, zero_samples[k] the block with the (k * ZERO_SAMPLE_RATE + 1)-th
+// zero, where select0() starts looking for it. The counts of ones and zeros are node counts, but
+// the bit positions and word counts are 64-bit: a tree of Count nodes has twice as many bits.
+class BitVector
 {
-    int checksum = node.node_id;
-    for (auto& c : node.children) {
-        checksum = (checksum + traverse(*c)) % 43112609;
+    static const int BLOCK_WORDS = 8;
+    static const uint64_t BLOCK_BITS = BLOCK_WORDS * 64;
+    static const uint64_t ZERO_SAMPLE_RATE = 512;
+    uint64_t n_words, n_blocks;
+    uint64_t* words;
+    Count* rank_samples = nullptr;
+    uint64_t* zero_samples = nullptr;
+
+    uint64_t zeros_before(uint64_t block) const
+    {
+        return block * BLOCK_BITS - rank_samples[block];
     }
-    return checksum;
-}
 
-using hrclock = std::chrono::high_resolution_clock;
-using ddur = std::chrono::duration<double>;
-using time_point = hrclock::time_point;
-using duration = hrclock::duration;
+public:
+    BitVector(region::Allocator& a, uint64_t n_bits)
+        : n_words(n_bits / 64 + 1),
+          n_blocks(n_words / BLOCK_WORDS + 1),
+          words(a.new_array<uint64_t>(n_blocks * BLOCK_WORDS))
+    {
+        std::fill(words, words + n_blocks * BLOCK_WORDS, 0);
+    }
+    void set(uint64_t i) { words[i / 64] |= uint64_t(1) << (i % 64); }
 
-struct Report
-{
-    duration build, traversal, deallocation;
-    int checksum;
-    AllocationStat allocations;
+    // Builds the samples, after the last set().
+    void index(region::Allocator& a)
+    {
+        rank_samples = a.new_array<Count>(n_blocks + 1);
+        zero_samples = a.new_array<uint64_t>(n_blocks * BLOCK_BITS / ZERO_SAMPLE_RATE + 1);
+        uint64_t ones = 0, n_zero_samples = 0;
+        for (uint64_t b = 0; b < n_blocks; ++b) {
+            rank_samples[b] = ones;
+            for (uint64_t w = b * BLOCK_WORDS; w < (b + 1) * BLOCK_WORDS; ++w) {
+                ones += __builtin_popcountll(words[w]);
+            }
+            while (n_zero_samples * ZERO_SAMPLE_RATE < (b + 1) * BLOCK_BITS - ones) {
+                zero_samples[n_zero_samples++] = b;
+            }
+        }
+        rank_samples[n_blocks] = ones;
+    }
 
-    duration total() const { return build + traversal + deallocation; }
+    // Number of ones before position i.
+    Count rank1(uint64_t i) const
+    {
+        uint64_t w = i / 64;
+        Count rank = rank_samples[w / BLOCK_WORDS];
+        for (uint64_t j = w / BLOCK_WORDS * BLOCK_WORDS; j < w; ++j) {
+            rank += __builtin_popcountll(words[j]);
+        }
+        return rank + __builtin_popcountll(words[w] & ((uint64_t(1) << (i % 64)) - 1));
+    }
+
+    // Position of the k-th zero, counting from 1.
+    uint64_t select0(uint64_t k) const
+    {
+        uint64_t b = zero_samples[(k - 1) / ZERO_SAMPLE_RATE];
+        while (zeros_before(b + 1) < k) {
+            ++b;
+        }
+        uint64_t zeros = zeros_before(b), w = b * BLOCK_WORDS;
+        for (int word_zeros; zeros + (word_zeros = 64 - __builtin_popcountll(words[w])) < k; ++w) {
+            zeros += word_zeros;
+        }
+        uint64_t inverted = ~words[w];
+        for (; zeros + 1 < k; ++zeros) {
+            inverted &= inverted - 1;  // Clears the lowest zero of the word.
+        }
+        return w * 64 + __builtin_ctzll(inverted);
+    }
+
+    // Position of the first zero from position i.
+    uint64_t next0(uint64_t i) const
+    {
+        uint64_t w = i / 64;
+        uint64_t inverted = ~words[w] & ~((uint64_t(1) << (i % 64)) - 1);
+        while (!inverted) {
+            inverted = ~words[++w];
+        }
+        return w * 64 + __builtin_ctzll(inverted);
+    }
+
+    size_t bytes() const
+    {
+        return n_blocks * BLOCK_WORDS * 8 + (n_blocks + 1) * sizeof(Count) +
+               (n_blocks * BLOCK_BITS / ZERO_SAMPLE_RATE + 1) * sizeof(Count);
+    }
 };
 
-template <class Allocator, class Node>
-Report test(const char* name)
+// Unsigned integers of `width` bits each, packed into 64-bit words.
+class PackedArray
 {
-    g_stat = AllocationStat{};
-    fprintf(stderr, "-- Testing: %s\n", name);
-    time_point t0, t1, t2, t3, t4, t5;
-    int checksum;
+    uint64_t n_words;
+    uint64_t* words;
+    int width;
+
+public:
+    PackedArray(region::Allocator& a, Count size, int width)
+        : n_words((uint64_t)size * width / 64 + 2),
+          words(a.new_array<uint64_t>(n_words)),
+          width(width)
     {
-        Allocator allocator;
-        t0 = hrclock::now();
-        auto r = build_tree<Allocator, Node>(allocator);
-        t1 = hrclock::now();
-        t2 = hrclock::now();
-        checksum = traverse(r);
-        t3 = hrclock::now();
-        t4 = hrclock::now();
+        std::fill(words, words + n_words, 0);
     }
-    t5 = hrclock::now();
-    return Report{t1 - t0, t3 - t2, t5 - t4, checksum, g_stat};
-}
+    void set(Count i, uint64_t x)
+    {
+        uint64_t bit = (uint64_t)i * width;
+        words[bit / 64] |= x << (bit % 64);
+        if (bit % 64 + width > 64) {
+            words[bit / 64 + 1] |= x >> (64 - bit % 64);
+        }
+    }
+    uint64_t get(Count i) const
+    {
+        uint64_t bit = (uint64_t)i * width;
+        uint64_t x = words[bit / 64] >> (bit % 64);
+        if (bit % 64 + width > 64) {
+            x |= words[bit / 64 + 1] << (64 - bit % 64);
+        }
+        return x & ((uint64_t(1) << width) - 1);
+    }
+
+    size_t bytes() const { return n_words * 8; }
+};
 
-int main()
+class Tree;
+
+// View of a node of a succinct tree with the members of the pointer-based nodes which traverse()
+// uses, node_id and children. Each element of children dereferences to a pointer to the view of
+// the child.
+struct NodeRef
 {
-    fprintf(stderr, "Benchmarking the building, traversal and deallocation of a tree using:\n\n");
-    fprintf(stderr,
-            "1. The usual, RAII-style storage (node holds a vector of owning pointers\n   to the "
-            "children)\n");
-    fprintf(stderr,
-            "2. Region-style allocator: all memory is allocated from a local pool (region) and\n");
-    fprintf(stderr, "   deallocated at once when the region goes out of scope.\n\n");
-    auto region = test<without_raii::Allocator, without_raii::Node>("Region-allocator");
-    auto raii = test<with_raii::Allocator, with_raii::Node>("RAII-allocator");
-    fprintf(stderr, "\n");
+    class ChildIterator;
 
-    if (region.allocations.n_nodes_created != raii.allocations.n_nodes_created ||
-        region.checksum != raii.checksum) {
-        fprintf(stderr, "Internal error, different checksum or number of nodes created.\n");
-        std::terminate();
-    }
-    fprintf(stderr, "Tree node count: %d (%d levels, %d children/node)\n\n",
-            region.allocations.n_nodes_created, TREE_DEPTH, N_CHILDREN);
-    fprintf(stderr, "                            RAII    |   Region\n");
-    fprintf(stderr, "                    ----------------|-----------------\n");
-    auto sec = [](duration d) { return ddur(d).count(); };
-    fprintf(stderr, "        Build time: %6.3fs (%4.0f%%) | %6.3fs (100%%)\n", sec(raii.build),
-            100.0 * sec(raii.build) / sec(region.build), sec(region.build));
-    fprintf(stderr, "    Traversal time: %6.3fs (%4.0f%%) | %6.3fs (100%%)\n", sec(raii.traversal),
-            100.0 * sec(raii.traversal) / sec(region.traversal), sec(region.traversal));
-    fprintf(stderr, " Deallocation time: %6.3fs (%4.0f%%) | %6.3fs (100%%)\n", sec(raii.build),
-            100.0 * sec(raii.deallocation) / sec(region.deallocation), sec(region.deallocation));
-    fprintf(stderr, "        Total time: %6.3fs (%4.0f%%) | %6.3fs (100%%)\n", sec(raii.total()),
-            100.0 * sec(raii.total()) / sec(region.total()), sec(region.total()));
-    fprintf(stderr, "  Heap allocations:  %12d   | %12d\n", raii.allocations.n_allocations,
-            region.allocations.n_allocations);
-    fprintf(stderr, "Heap deallocations:  %12d   | %12d\n", raii.allocations.n_frees,
-            region.allocations.n_frees);
-    fprintf(stderr, "   Bytes allocated:  %12.3fMB | %12.3fMB\n",
-            raii.allocations.total_bytes_allocated / 1e6,
-            region.allocations.total_bytes_allocated / 1e6);
+    // The children of a node are the `size` nodes from `first`, in level order.
+    struct Children
+    {
+        const Tree* tree;
+        Count first;
+        int size;
+
+        ChildIterator begin() const;
+        ChildIterator end() const;
+    };
+
+    Count node_id;
+    Children children;
+};
+
+// Has the view of the current child, which the pointer it dereferences to points to. Only the
+// children before `end` are decoded.
+class NodeRef::ChildIterator
+{
+    const Tree* tree;
+    Count index, end;
+    uint64_t description;
+    NodeRef child;
+    mutable const NodeRef* pointer = &child;
+
+public:
+    ChildIterator(const Tree* tree, Count index, Count end, uint64_t description);
+    ChildIterator(const ChildIterator& other)
+        : tree(other.tree),
+          index(other.index),
+          end(other.end),
+          description(other.description),
+          child(other.child)
+    {}
+    const NodeRef* const& operator*() const { return pointer = &child; }
+    ChildIterator& operator++();
+    bool operator!=(const ChildIterator& other) const { return index != other.index; }
+};
+
+// Level-order unary degree sequence (LOUDS) tree. The description of each node is a one for each
+// of its children and a zero, the descriptions are in level order, after "10" for a virtual
+// super root. That's 2 bits per node, the description of node i starts after the (i + 1)-th zero
+// and its first child is the node with the number of ones before it as index. The node ids are
+// in level order too, packed into as many bits as the largest needs.
+class Tree
+{
+    friend struct NodeRef;
+    friend class NodeRef::ChildIterator;
+    Count n_nodes;
+    BitVector bits;
+    PackedArray ids;
+
+    NodeRef node(Count index, uint64_t description) const
+    {
+        // Leaves (most of the nodes) need no rank.
+        int n_children = bits.next0(description) - description;
+        Count first_child = n_children ? bits.rank1(description) : 0;
+        return {(Count)ids.get(index), {this, first_child, n_children}};
+    }
+
+public:
+    // Builds a complete tree of n_nodes nodes (of which the first n_inner_nodes have n_children
+    // children each) with the node ids from first_node_id, in level order.
+    Tree(region::Allocator& a,
+         Count n_nodes,
+         Count n_inner_nodes,
+         int n_children,
+         Count first_node_id)
+        : n_nodes(n_nodes),
+          bits(a, 2 * (uint64_t)n_nodes + 1),
+          ids(a, n_nodes, 64 - __builtin_clzll((uint64_t)first_node_id + n_nodes))
+    {
+        uint64_t position = 0;
+        bits.set(position);
+        position += 2;
+        for (Count i = 0; i < n_nodes; ++i) {
+            ids.set(i, first_node_id + i);
+            for (int c = 0; c < (i < n_inner_nodes ? n_children : 0); ++c) {
+                bits.set(position++);
+            }
+            ++position;
+        }
+        bits.index(a);
+    }
+
+    NodeRef root() const { return node(0, 2); }
+    Count size() const { return n_nodes; }
+    Count node_id(Count index) const { return ids.get(index); }
+    size_t bytes() const { return bits.bytes() + ids.bytes(); }
+};
+
+inline NodeRef::ChildIterator NodeRef::Children::begin() const
+{
+    return {tree, first, first + size, size ? tree->bits.select0(first + 1) + 1 : 0};
+}
+
+inline NodeRef::ChildIterator NodeRef::Children::end() const
+{
+    return {tree, first + size, first + size, 0};
+}
+
+inline NodeRef::ChildIterator::ChildIterator(const Tree* tree,
+                                             Count index,
+                                             Count end,
+                                             uint64_t description)
+    : tree(tree),
+      index(index),
+      end(end),
+      description(description),
+      child(index < end ? tree->node(index, description) : NodeRef{})
+{}
+
+inline NodeRef::ChildIterator& NodeRef::ChildIterator::operator++()
+{
+    // The description of the next sibling follows that of this one.
+    description += child.children.size + 1;
+    ++index;
+    if (index < end) {
+        child = tree->node(index, description);
+    }
+    return *this;
+}
+
+}  // namespace succinct
+
+namespace csr {
+
+// Compressed sparse row snapshot of a tree, in a region: the children of node i are the nodes
+// children[offsets[i]] to children[offsets[i + 1] - 1]. Made by freeze().
+struct Tree
+{
+    Count n_nodes = 0;
+    Count* offsets = nullptr;
+    Count* children = nullptr;
+    Count* node_id = nullptr;
+
+    Tree(region::Allocator& a, Count n_nodes)
+        : n_nodes(n_nodes),
+          offsets(a.new_array<Count>(n_nodes + 1)),
+          children(a.new_array<Count>(std::max<Count>(n_nodes - 1, 1))),
+          node_id(a.new_array<Count>(n_nodes))
+    {}
+
+    size_t bytes() const { return (3 * (size_t)n_nodes + 1) * sizeof(Count); }
+};
+
+// The order of the nodes in the arrays.
+enum class Order { BFS, DFS };
+
+}  // namespace csr
+
+// Shows the pages and large blocks allocated by the region allocators in the trace.
+void trace_region_heap_allocation(bool large_block, size_t bytes, time_point start)
+{
+    if (g_trace.enabled())
+        g_trace.span(large_block ? "large block" : "chunk", "region", start, hrclock::now(),
+                     "bytes", bytes);
+}
+
+// Used instead of trace_region_heap_allocation() with --file-backed: the memory mapped from the
+// file doesn't come from operator new, so its bytes are counted here.
+void count_mapped_allocation(bool large_block, size_t bytes, time_point start)
+{
+    g_stat.total_bytes_allocated += bytes;
+    trace_region_heap_allocation(large_block, bytes, start);
+}
+
+// Instruction set variants of the traversal. A single binary has to run on every x86-64 CPU, so
+// the variants are compiled with target attributes and the best one the CPU supports is selected
+// at run time.
+enum class Isa { BASELINE, X86_64_V3, X86_64_V4 };
+const char* const ISA_NAMES[] = {"baseline", "x86-64-v3", "x86-64-v4"};
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ISA_VARIANTS 1
+#else
+#define ISA_VARIANTS 0
+#endif
+
+bool isa_supported(Isa isa)
+{
+#if ISA_VARIANTS
+    switch (isa) {
+        case Isa::X86_64_V3:
+            return __builtin_cpu_supports("x86-64-v3");
+        case Isa::X86_64_V4:
+            return __builtin_cpu_supports("x86-64-v4");
+        default:
+            break;
+    }
+#endif
+    return isa == Isa::BASELINE;
+}
+
+Isa best_isa()
+{
+    for (Isa isa : {Isa::X86_64_V4, Isa::X86_64_V3}) {
+        if (isa_supported(isa)) {
+            return isa;
+        }
+    }
+    return Isa::BASELINE;
+}
+
+// Parameters of a single benchmark run.
+struct Config
+{
+    int tree_depth = TREE_DEPTH;
+    int n_children = N_CHILDREN;
+    region::Params region;  // Used only by the region allocator.
+    int n_threads = 1;      // Number of threads building the tree.
+    Isa isa = best_isa();   // Variant of the traversal.
+
+    Config() { region.on_heap_allocation = trace_region_heap_allocation; }
+};
+
+// Number of nodes below a node which has `levels` levels of descendants, each node having
+// n_children children.
+long long n_descendants(int n_children, int levels)
+{
+    long long n = 0, level_size = 1;
+    for (int i = 0; i < levels; ++i) {
+        level_size *= n_children;
+        n += level_size;
+    }
+    return n;
+}
+
+// Dense index of the nodes of a tree by node id: a region-allocated array of pointers, filled in
+// by build_tree().
+template <class Node>
+struct IdIndex
+{
+    Count first_id, size;
+    Node** nodes;
+
+    IdIndex(region::Allocator& a, Count first_id, Count size)
+        : first_id(first_id), size(size), nodes(a.new_array<Node*>(size))
+    {}
+    void add(Node& node) { nodes[node.node_id - first_id] = &node; }
+    Node* find(Count node_id) const { return nodes[node_id - first_id]; }
+    size_t bytes() const { return size * sizeof(Node*); }
+};
+
+// Build a subtree levels_left levels deep, each node having n_children children, adding the new
+// nodes to index, if any.
+template <class Allocator, class Node>
+void build_subtree(Allocator& allocator,
+                   Node& node,
+                   int levels_left,
+                   int n_children,
+                   IdIndex<Node>* index = nullptr)
+{
+    for (int i = 0; i < n_children; ++i)
+        node.add_child(allocator, n_children);
+    for (auto& c : node.children) {
+        if (index) {
+            index->add(*c);
+        }
+        if (levels_left > 1) {
+            build_subtree(allocator, *c, levels_left - 1, n_children, index);
+        }
+    }
+}
+
+// Collect the nodes `level` levels below node.
+template <class Node>
+void collect_level(Node& node, int level, vector<Node*>& result)
+{
+    if (level == 0) {
+        result.push_back(&node);
+        return;
+    }
+    for (auto& c : node.children) {
+        collect_level(*c, level - 1, result);
+    }
+}
+
+// Build `levels` levels below node, numbering the nodes as build_subtree() does when it builds
+// `levels_below` levels below node and the first child gets first_child_id. The nodes of the last
+// level are appended to tasks, each with the id build_subtree() gives its first child.
+template <class Allocator, class Node>
+void build_top_levels(Allocator& allocator,
+                      Node& node,
+                      int levels,
+                      int levels_below,
+                      int n_children,
+                      Count first_child_id,
+                      vector<std::pair<Node*, Count>>& tasks,
+                      IdIndex<Node>* index)
+{
+    g_stat.n_nodes_created = first_child_id;
+    for (int i = 0; i < n_children; ++i)
+        node.add_child(allocator, n_children);
+    const long long child_descendants = n_descendants(n_children, levels_below - 1);
+    Count next_id = first_child_id + n_children;
+    for (auto& c : node.children) {
+        if (index) {
+            index->add(*c);
+        }
+        if (levels > 1) {
+            build_top_levels(allocator, *c, levels - 1, levels_below - 1, n_children, next_id,
+                             tasks, index);
+        } else {
+            tasks.emplace_back(&*c, next_id);
+        }
+        next_id += child_descendants;
+    }
+}
+
+// Build the tree described by config. With more than one thread, the top levels are built on the
+// calling thread, then the subtrees below them are distributed among the threads: the calling
+// thread allocates from `allocator`, thread i from worker_allocators[i - 1]. Every node gets the
+// id a single-threaded build_subtree() would give it, so the ids and the checksum don't depend on
+// the thread count. The nodes below the root are added to index, if any; the root is returned by
+// value, so the caller adds it.
+template <class Allocator, class Node>
+Node build_tree(Allocator& allocator,
+                vector<unique_ptr<Allocator>>& worker_allocators,
+                const Config& config,
+                IdIndex<Node>* index)
+{
+    const int n_children = config.n_children;
+    Node root(allocator, n_children);
+    if (worker_allocators.empty()) {
+        build_subtree(allocator, root, config.tree_depth, n_children, index);
+        return root;
+    }
+
+    // Build enough levels here to have at least one subtree per thread.
+    const int n_threads = worker_allocators.size() + 1;
+    int top_levels = 1;
+    long long n_tasks = n_children;
+    while (n_tasks < n_threads && top_levels < config.tree_depth) {
+        ++top_levels;
+        n_tasks *= n_children;
+    }
+    const Count first_child_id = g_stat.n_nodes_created;
+    const Count end_id = first_child_id + n_descendants(n_children, config.tree_depth);
+    vector<std::pair<Node*, Count>> tasks;
+    build_top_levels(allocator, root, top_levels, config.tree_depth, n_children, first_child_id,
+                     tasks, index);
+    const int levels_below = config.tree_depth - top_levels;
+    if (levels_below == 0) {
+        g_stat.n_nodes_created = end_id;
+        return root;
+    }
+
+    // Thread t builds the subtrees below tasks[task_begin(t), task_begin(t + 1)).
+    auto task_begin = [&](int t) { return (int)(t * n_tasks / n_threads); };
+    auto build_tasks = [&](Allocator& a, int t) {
+        auto t0 = hrclock::now();
+        g_thread_index = t;
+        for (int i = task_begin(t); i < task_begin(t + 1); ++i) {
+            g_stat.n_nodes_created = tasks[i].second;
+            build_subtree(a, *tasks[i].first, levels_below, n_children, index);
+        }
+        if (g_trace.enabled()) {
+            char thread_name[32];
+            snprintf(thread_name, sizeof(thread_name), "build thread %d", t);
+            g_trace.thread_name(t, thread_name);
+            g_trace.span("build task", "task", t0, hrclock::now(), "subtrees",
+                         task_begin(t + 1) - task_begin(t));
+        }
+    };
+    vector<AllocationStat> worker_stats(n_threads - 1);
+    vector<std::thread> threads;
+    for (int t = 1; t < n_threads; ++t) {
+        threads.emplace_back([&, t] {
+            build_tasks(*worker_allocators[t - 1], t);
+            worker_stats[t - 1] = g_stat;
+        });
+    }
+    build_tasks(allocator, 0);
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    g_stat.n_nodes_created = end_id;
+    for (auto& s : worker_stats) {
+        g_stat.total_bytes_allocated += s.total_bytes_allocated;
+        g_stat.n_allocations += s.n_allocations;
+        g_stat.n_frees += s.n_frees;
+    }
+    return root;
+}
+
+template <class Allocator, class Node>
+Node build_tree(Allocator& allocator,
+                vector<unique_ptr<Allocator>>& worker_allocators,
+                const Config& config)
+{
+    return build_tree<Allocator, Node>(allocator, worker_allocators, config, nullptr);
+}
+
+// The SoA tree is built directly into its arrays, in parallel: thread t fills the fields of a
+// range of the nodes. All the arrays come from the allocator of the calling thread.
+template <>
+soa::Tree build_tree<region::Allocator, soa::Tree>(
+    region::Allocator& allocator,
+    vector<unique_ptr<region::Allocator>>& worker_allocators,
+    const Config& config)
+{
+    const int n_children = config.n_children;
+    const Count n_nodes = 1 + n_descendants(n_children, config.tree_depth);
+    const Count n_inner_nodes = 1 + n_descendants(n_children, config.tree_depth - 1);
+    soa::Tree tree(allocator, n_nodes);
+    const Count first_node_id = g_stat.n_nodes_created;
+    g_stat.n_nodes_created += n_nodes;
+
+    const int n_threads = worker_allocators.size() + 1;
+    auto fill = [&](int t) {
+        auto t0 = hrclock::now();
+        const Count begin = (long long)t * n_nodes / n_threads;
+        const Count end = (long long)(t + 1) * n_nodes / n_threads;
+        for (Count i = begin; i < end; ++i) {
+            tree.node_id[i] = first_node_id + i;
+            bool inner = i < n_inner_nodes;
+            tree.first_child[i] = inner ? i * n_children + 1 : 0;
+            tree.n_children[i] = inner ? n_children : 0;
+        }
+        if (g_trace.enabled() && n_threads > 1) {
+            g_trace.span("build task", "task", t0, hrclock::now(), "nodes", end - begin);
+        }
+    };
+    vector<std::thread> threads;
+    for (int t = 1; t < n_threads; ++t) {
+        threads.emplace_back(fill, t);
+    }
+    fill(0);
+    for (auto& t : threads) {
+        t.join();
+    }
+    return tree;
+}
+
+// The hash-consed tree is built on the calling thread, the builder's hash table is not shared.
+// The root is copied out of the region, like the roots of the other trees.
+template <>
+dag::Node build_tree<region::Allocator, dag::Node>(region::Allocator& allocator,
+                                                  vector<unique_ptr<region::Allocator>>&,
+                                                  const Config& config)
+{
+    ++g_stat.n_nodes_created;
+    dag::Builder builder(allocator);
+    return *builder.build(config.tree_depth, config.n_children);
+}
+
+// The succinct tree is built on the calling thread, the bits are set in order.
+template <>
+succinct::Tree build_tree<region::Allocator, succinct::Tree>(
+    region::Allocator& allocator,
+    vector<unique_ptr<region::Allocator>>&,
+    const Config& config)
+{
+    const Count n_nodes = 1 + n_descendants(config.n_children, config.tree_depth);
+    const Count n_inner_nodes = 1 + n_descendants(config.n_children, config.tree_depth - 1);
+    const Count first_node_id = g_stat.n_nodes_created;
+    g_stat.n_nodes_created += n_nodes;
+    return succinct::Tree(allocator, n_nodes, n_inner_nodes, config.n_children, first_node_id);
+}
+
+// The allocators of the build threads other than the calling one (see build_tree()), each made
+// from args.
+template <class Allocator, class... Args>
+vector<unique_ptr<Allocator>> make_worker_allocators(int n_threads, const Args&... args)
+{
+    vector<unique_ptr<Allocator>> worker_allocators;
+    for (int i = 1; i < n_threads; ++i) {
+        worker_allocators.push_back(make_unique<Allocator>(args...));
+    }
+    return worker_allocators;
+}
+
+// The configured tree, built by build_tree() into allocators which live as long as it does.
+// g_stat is reset first, so it counts the allocators and the build.
+template <class Allocator, class Node>
+struct BuiltTree
+{
+    struct ResetStat
+    {
+        ResetStat() { g_stat = AllocationStat{}; }
+    } reset_stat;
+    Allocator allocator;
+    vector<unique_ptr<Allocator>> worker_allocators;
+    Node root;
+
+    explicit BuiltTree(const Config& config)
+        : allocator(config.region),
+          worker_allocators(make_worker_allocators<Allocator>(config.n_threads, config.region)),
+          root(build_tree<Allocator, Node>(allocator, worker_allocators, config))
+    {}
+    BuiltTree(const Config& config, IdIndex<Node>& index)
+        : allocator(config.region),
+          worker_allocators(make_worker_allocators<Allocator>(config.n_threads, config.region)),
+          root(build_tree<Allocator, Node>(allocator, worker_allocators, config, &index))
+    {}
+};
+
+namespace lazy {
+
+// Region tree node whose children are built when they are first accessed, one level at a time,
+// by build_subtree(). Only the parts of the tree which are visited are ever allocated.
+struct Node
+{
+    region::Vector<Node*> children;
+    const Count node_id = g_stat.n_nodes_created++;
+    const int levels_below;  // Levels of descendants, built or not.
+    bool built = false;
+
+    Node(region::Allocator& a, int max_n_children, int levels_below)
+        : children(a, max_n_children), levels_below(levels_below)
+    {}
+    void add_child(region::Allocator& a, int max_n_children)
+    {
+        children.push_back(a.new_object<Node>(a, max_n_children, levels_below - 1));
+    }
+    const region::Vector<Node*>& get_children(region::Allocator& a, int n_children)
+    {
+        if (!built && levels_below > 0) {
+            build_subtree(a, *this, 1, n_children);
+            built = true;
+        }
+        return children;
+    }
+};
+
+}  // namespace lazy
+
+// Variable-length (LEB128) integers: 7 bits per byte, the high bit set on all but the last one.
+void put_varint(vector<uint8_t>& bytes, uint64_t x)
+{
+    for (; x >= 0x80; x >>= 7) {
+        bytes.push_back(x | 0x80);
+    }
+    bytes.push_back(x);
+}
+
+uint64_t get_varint(const uint8_t*& p)
+{
+    uint64_t x = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t b = *p++;
+        x |= uint64_t(b & 0x7f) << shift;
+        if (b < 0x80) {
+            return x;
+        }
+    }
+}
+
+namespace cold {
+
+// Region tree node whose descendants can be stored packed into a byte stream in the region,
+// which is expanded into nodes when get_children() is first called. For each node of the packed
+// subtree, in depth-first order, the stream has the number of its children, then for each child
+// the difference of its id from that of the previous child (the first from that of the parent),
+// zigzag-encoded, followed by the child's own part.
+struct Node
+{
+    region::Vector<Node*> children;
+    const Count node_id;
+    const uint8_t* packed = nullptr;  // The packed descendants, until they are expanded.
+
+    Node(region::Allocator& a, int max_n_children, Count node_id)
+        : children(a, max_n_children), node_id(node_id)
+    {}
+
+    // Copies the tree of source, packing the subtrees of the nodes levels_hot levels below it.
+    // buffer is reused for the streams.
+    template <class SourceNode>
+    static Node* pack(region::Allocator& a,
+                      const SourceNode& source,
+                      int levels_hot,
+                      int max_n_children,
+                      vector<uint8_t>& buffer)
+    {
+        Node* node = a.new_object<Node>(a, max_n_children, source.node_id);
+        if (levels_hot > 0) {
+            for (auto& c : source.children) {
+                node->children.push_back(pack(a, *c, levels_hot - 1, max_n_children, buffer));
+            }
+        } else if (source.children.begin() != source.children.end()) {
+            buffer.clear();
+            put_descendants(buffer, source);
+            uint8_t* packed = a.new_array<uint8_t>(buffer.size());
+            std::copy(buffer.begin(), buffer.end(), packed);
+            node->packed = packed;
+        }
+        return node;
+    }
+
+    // Expands the descendants first, returns whether it did.
+    bool expand(region::Allocator& a, int max_n_children)
+    {
+        if (!packed) {
+            return false;
+        }
+        get_descendants(a, *this, packed, max_n_children);
+        packed = nullptr;
+        return true;
+    }
+
+    const region::Vector<Node*>& get_children(region::Allocator& a, int max_n_children)
+    {
+        expand(a, max_n_children);
+        return children;
+    }
+
+private:
+    template <class SourceNode>
+    static void put_descendants(vector<uint8_t>& buffer, const SourceNode& node)
+    {
+        put_varint(buffer, node.children.end() - node.children.begin());
+        Count previous_id = node.node_id;
+        for (auto& c : node.children) {
+            int64_t delta = (int64_t)c->node_id - (int64_t)previous_id;
+            put_varint(buffer, (uint64_t(delta) << 1) ^ uint64_t(delta >> 63));
+            previous_id = c->node_id;
+            put_descendants(buffer, *c);
+        }
+    }
+
+    static void get_descendants(region::Allocator& a,
+                                Node& node,
+                                const uint8_t*& p,
+                                int max_n_children)
+    {
+        Count previous_id = node.node_id;
+        for (uint64_t n = get_varint(p); n > 0; --n) {
+            uint64_t zigzag = get_varint(p);
+            Count id = previous_id + (int64_t)(zigzag >> 1 ^ -(zigzag & 1));
+            Node* child = a.new_object<Node>(a, max_n_children, id);
+            node.children.push_back(child);
+            previous_id = id;
+            get_descendants(a, *child, p, max_n_children);
+        }
+    }
+};
+
+}  // namespace cold
+
+namespace by_depth {
+
+// Allocator with a region for the top levels of the tree (levels 0 to top_levels - 1), one for
+// the other inner nodes and one for the leaves (at leaf_depth), so the nodes visited by every
+// traversal are packed together, apart from those visited once.
+struct Allocator
+{
+    region::Allocator top, inner, leaves;
+    const int top_levels, leaf_depth;
+
+    Allocator(const region::Params& top_params,
+              const region::Params& params,
+              int top_levels,
+              int leaf_depth)
+        : top(top_params), inner(params), leaves(params), top_levels(top_levels),
+          leaf_depth(leaf_depth)
+    {}
+    region::Allocator& at_depth(int depth)
+    {
+        return depth < top_levels ? top : depth < leaf_depth ? inner : leaves;
+    }
+};
+
+// Deepest level the nodes can store, depth_regions() rejects deeper trees.
+const int MAX_DEPTH = std::numeric_limits<uint8_t>::max();
+
+// Region tree node allocated (with its array of children) from the region of its depth. The
+// depth fits into the padding after a 32-bit node_id.
+struct Node
+{
+    region::Vector<Node*> children;
+    Count node_id = g_stat.n_nodes_created++;
+    uint8_t depth;
+
+    Node(Allocator& a, int max_n_children, int depth = 0)
+        : children(a.at_depth(depth), max_n_children), depth(depth)
+    {}
+    void add_child(Allocator& a, int max_n_children)
+    {
+        children.push_back(a.at_depth(depth + 1).new_object<Node>(a, max_n_children, depth + 1));
+    }
+};
+
+}  // namespace by_depth
+
+// The part of the checksum a node id contributes. 32-bit ids are added as they are, 64-bit ones
+// need to be reduced first to fit into the checksum.
+inline int id_checksum(Count node_id)
+{
+    return sizeof(Count) == sizeof(int) ? node_id : node_id % 43112609;
+}
+
+// Traverse the tree (depth-first), calculate checksum. The traversal is compiled for each Isa,
+// recurse is the variant being run.
+template <class Node>
+#if defined(__GNUC__)
+__attribute__((always_inline))
+#endif
+inline int traverse_node(const Node& node, int (*recurse)(const Node&))
+{
+    int checksum = id_checksum(node.node_id);
+    for (auto& c : node.children) {
+        checksum = (checksum + recurse(*c)) % 43112609;
+    }
+    return checksum;
+}
+
+template <class Node>
+int traverse_baseline(const Node& node)
+{
+    return traverse_node(node, traverse_baseline<Node>);
+}
+
+#if ISA_VARIANTS
+template <class Node>
+__attribute__((target("arch=x86-64-v3"))) int traverse_x86_64_v3(const Node& node)
+{
+    return traverse_node(node, traverse_x86_64_v3<Node>);
+}
+
+template <class Node>
+__attribute__((target("arch=x86-64-v4"))) int traverse_x86_64_v4(const Node& node)
+{
+    return traverse_node(node, traverse_x86_64_v4<Node>);
+}
+#endif
+
+template <class Node>
+int traverse(const Node& node, Isa isa)
+{
+    switch (isa) {
+#if ISA_VARIANTS
+        case Isa::X86_64_V3:
+            return traverse_x86_64_v3(node);
+        case Isa::X86_64_V4:
+            return traverse_x86_64_v4(node);
+#endif
+        default:
+            return traverse_baseline(node);
+    }
+}
+
+// The SoA traversal has no ISA variants.
+int traverse_soa(const soa::Tree& tree, Count node)
+{
+    int checksum = id_checksum(tree.node_id[node]);
+    for (Count c = tree.first_child[node], end = c + tree.n_children[node]; c < end; ++c) {
+        checksum = (checksum + traverse_soa(tree, c)) % 43112609;
+    }
+    return checksum;
+}
+
+int traverse(const soa::Tree& tree, Isa)
+{
+    return traverse_soa(tree, 0);
+}
+
+// first_descendant_id is the id of the first child, the ids of the children are consecutive,
+// then come the descendants of the first child, and so on, as in build_subtree().
+int traverse_dag(const dag::Node& node, Count node_id, Count first_descendant_id)
+{
+    int checksum = id_checksum(node_id);
+    const int n_children = node.children.end() - node.children.begin();
+    Count descendant_id = first_descendant_id + n_children;
+    for (int i = 0; i < n_children; ++i) {
+        const dag::Node& c = *node.children.begin()[i];
+        checksum = (checksum + traverse_dag(c, first_descendant_id + i, descendant_id)) % 43112609;
+        descendant_id += c.n_descendants;
+    }
+    return checksum;
+}
+
+int traverse(const dag::Node& root, Isa)
+{
+    return traverse_dag(root, 0, 1);
+}
+
+// The CSR traversal has no ISA variants.
+int traverse_csr(const csr::Tree& tree, Count node)
+{
+    int checksum = id_checksum(tree.node_id[node]);
+    for (Count i = tree.offsets[node]; i < tree.offsets[node + 1]; ++i) {
+        checksum = (checksum + traverse_csr(tree, tree.children[i])) % 43112609;
+    }
+    return checksum;
+}
+
+int traverse(const csr::Tree& tree, Isa)
+{
+    return traverse_csr(tree, 0);
+}
+
+// The succinct tree is traversed through the views of its nodes.
+int traverse(const succinct::Tree& tree, Isa isa)
+{
+    return traverse(tree.root(), isa);
+}
+
+inline void prefetch(const void* p)
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(p);
+#endif
+}
+
+// Traverses the subtrees of roots with group_size cursors, each walking a subtree at a time with
+// its own stack, taking turns after each step (asynchronous memory access chaining). A step which
+// needs memory which may not be in the cache only prefetches it, and it is used at the cursor's
+// next turn, after the other cursors' steps, which overlaps the cache misses of the cursors.
+// Returns the checksum of the subtrees.
+template <class Node>
+int traverse_interleaved(const vector<Node*>& roots, int group_size)
+{
+    struct Cursor
+    {
+        vector<const Node*> stack;  // The top is prefetched.
+        const Node* node = nullptr;  // Its children are prefetched, if children_next.
+        bool children_next = false;
+        bool done = false;
+    };
+    vector<Cursor> cursors(group_size);
+    size_t next_root = 0;
+    int checksum = 0;
+    for (int n_active = group_size; n_active > 0;) {
+        for (auto& c : cursors) {
+            if (c.done) {
+                continue;
+            }
+            if (c.children_next) {
+                for (auto& child : c.node->children) {
+                    c.stack.push_back(&*child);
+                }
+                prefetch(c.stack.back());
+                c.children_next = false;
+            } else if (!c.stack.empty()) {
+                c.node = c.stack.back();
+                c.stack.pop_back();
+                checksum = (checksum + id_checksum(c.node->node_id)) % 43112609;
+                c.children_next = c.node->children.begin() != c.node->children.end();
+                if (c.children_next) {
+                    prefetch(&*c.node->children.begin());
+                } else if (!c.stack.empty()) {
+                    prefetch(c.stack.back());
+                }
+            } else if (next_root < roots.size()) {
+                c.stack.push_back(roots[next_root++]);
+                prefetch(c.stack.back());
+            } else {
+                c.done = true;
+                --n_active;
+            }
+        }
+    }
+    return checksum;
+}
+
+// Visitors of visit(). pre() is called for each node before its descendants, post() after them,
+// with the depth of the node (0 at the root). The state is in the members of the visitor.
+struct Visitor
+{
+    template <class Node>
+    void pre(const Node&, int)
+    {}
+    template <class Node>
+    void post(const Node&, int)
+    {}
+};
+
+// The checksum of traverse().
+struct ChecksumVisitor : Visitor
+{
+    int checksum = 0;
+
+    template <class Node>
+    void pre(const Node& node, int)
+    {
+        checksum = (checksum + id_checksum(node.node_id)) % 43112609;
+    }
+    long long result() const { return checksum; }
+};
+
+struct CountVisitor : Visitor
+{
+    Count n_nodes = 0;
+
+    template <class Node>
+    void pre(const Node&, int)
+    {
+        ++n_nodes;
+    }
+    long long result() const { return n_nodes; }
+};
+
+// The sum and the maximum of the depths of the nodes.
+struct DepthVisitor : Visitor
+{
+    long long depth_sum = 0;
+    int max_depth = 0;
+
+    template <class Node>
+    void pre(const Node&, int depth)
+    {
+        depth_sum += depth;
+        max_depth = std::max(max_depth, depth);
+    }
+    long long result() const { return depth_sum * 64 + max_depth; }
+};
+
+// Counts the leaves, after their subtrees (post-order).
+struct LeafVisitor : Visitor
+{
+    Count n_leaves = 0;
+
+    template <class Node>
+    void post(const Node& node, int)
+    {
+        n_leaves += node.children.begin() == node.children.end();
+    }
+    long long result() const { return n_leaves; }
+};
+
+// Runs all the visitors in a single depth-first pass over the tree of root, and returns them.
+// The walk is a loop over an explicit stack, and the visitors are copies local to it, so the
+// compiler can keep their state in registers instead of loading and storing it at each node.
+template <class Node, class... Visitors>
+std::tuple<Visitors...> visit(const Node& root, Visitors... visitors)
+{
+    using Iterator = decltype(root.children.begin());
+    struct Frame
+    {
+        const Node* node;
+        Iterator next;
+    };
+    vector<Frame> stack;
+    (visitors.pre(root, 0), ...);
+    stack.push_back({&root, root.children.begin()});
+    while (!stack.empty()) {
+        Frame& frame = stack.back();
+        const int depth = stack.size() - 1;
+        if (frame.next == frame.node->children.end()) {
+            (visitors.post(*frame.node, depth), ...);
+            stack.pop_back();
+            continue;
+        }
+        const Node& child = **frame.next++;
+        (visitors.pre(child, depth + 1), ...);
+        stack.push_back({&child, child.children.begin()});
+    }
+    return {visitors...};
+}
+
+namespace euler {
+
+// Index of a tree with dense node ids answering subtree and lowest common ancestor queries in
+// constant time. The nodes are numbered in preorder, so each subtree is a range of the numbers,
+// and the prefix sums of the id checksums give the checksum of any range. The LCA of two nodes is
+// the shallowest node of the Euler tour (each node, before and after each of its children) between
+// their first occurrences, found with a sparse table of the minima of blocks of the tour and
+// scans of the partial blocks at the ends. All the arrays are allocated from a region.
+class Index
+{
+    static const Count BLOCK = 32;
+    Count first_id, n_nodes;
+    Count* preorder;          // By node id - first_id.
+    Count* first_occurrence;  // In the tour, by node id - first_id.
+    Count* subtree_end;       // By preorder number: one past the last number of the subtree.
+    int* prefix_checksum;     // By preorder number: of the nodes before it.
+    Count tour_size = 0;
+    Count* tour;  // Node ids.
+    int* tour_depth;
+    Count n_blocks;
+    int n_levels = 1;
+    Count* block_min;  // n_levels rows: the tour position of the minimum of 2^level blocks.
+
+    template <class Node>
+    void add(const Node& node, int depth, Count& next)
+    {
+        const Count p = next++;
+        preorder[node.node_id - first_id] = p;
+        first_occurrence[node.node_id - first_id] = tour_size;
+        prefix_checksum[p + 1] = (prefix_checksum[p] + id_checksum(node.node_id)) % 43112609;
+        tour[tour_size] = node.node_id;
+        tour_depth[tour_size++] = depth;
+        for (auto& c : node.children) {
+            add(*c, depth + 1, next);
+            tour[tour_size] = node.node_id;
+            tour_depth[tour_size++] = depth;
+        }
+        subtree_end[p] = next;
+    }
+
+    // Returns the position of the shallower one.
+    Count min(Count a, Count b) const { return tour_depth[b] < tour_depth[a] ? b : a; }
+    Count scan(Count begin, Count end) const
+    {
+        Count m = begin;
+        for (Count i = begin + 1; i < end; ++i) {
+            m = min(m, i);
+        }
+        return m;
+    }
+
+public:
+    // Length of the tour of a tree of n_nodes nodes, which the tour positions (Count) must hold.
+    static size_t tour_capacity(long long n_nodes) { return 2 * (size_t)n_nodes - 1; }
+
+    // Indexes the tree of root, whose n_nodes nodes have the ids from first_id, in one pass.
+    template <class Node>
+    Index(region::Allocator& a, const Node& root, Count first_id, Count n_nodes)
+        : first_id(first_id),
+          n_nodes(n_nodes),
+          preorder(a.new_array<Count>(n_nodes)),
+          first_occurrence(a.new_array<Count>(n_nodes)),
+          subtree_end(a.new_array<Count>(n_nodes)),
+          prefix_checksum(a.new_array<int>(n_nodes + 1)),
+          tour(a.new_array<Count>(tour_capacity(n_nodes))),
+          tour_depth(a.new_array<int>(tour_capacity(n_nodes))),
+          n_blocks((tour_capacity(n_nodes) + BLOCK - 1) / BLOCK)
+    {
+        Count next = 0;
+        prefix_checksum[0] = 0;
+        add(root, 0, next);
+
+        while (Count(1) << n_levels <= n_blocks) {
+            ++n_levels;
+        }
+        block_min = a.new_array<Count>((size_t)n_levels * n_blocks);
+        for (Count b = 0; b < n_blocks; ++b) {
+            block_min[b] = scan(b * BLOCK, std::min(tour_size, (b + 1) * BLOCK));
+        }
+        for (int level = 1; level < n_levels; ++level) {
+            Count* row = block_min + (size_t)level * n_blocks;
+            const Count* previous = row - n_blocks;
+            const Count half = Count(1) << (level - 1);
+            for (Count b = 0; b + 2 * half <= n_blocks; ++b) {
+                row[b] = min(previous[b], previous[b + half]);
+            }
+        }
+    }
+
+    Count subtree_size(Count id) const
+    {
+        Count p = preorder[id - first_id];
+        return subtree_end[p] - p;
+    }
+    int subtree_checksum(Count id) const
+    {
+        Count p = preorder[id - first_id];
+        return (prefix_checksum[subtree_end[p]] - prefix_checksum[p] + 43112609) % 43112609;
+    }
+    Count lca(Count a, Count b) const
+    {
+        Count l = first_occurrence[a - first_id], r = first_occurrence[b - first_id];
+        if (l > r) {
+            std::swap(l, r);
+        }
+        Count lb = l / BLOCK, rb = r / BLOCK, m;
+        if (lb == rb) {
+            m = scan(l, r + 1);
+        } else {
+            m = min(scan(l, (lb + 1) * BLOCK), scan(rb * BLOCK, r + 1));
+            if (lb + 1 < rb) {
+                int level = 63 - __builtin_clzll(rb - lb - 1);
+                const Count* row = block_min + (size_t)level * n_blocks;
+                m = min(m, min(row[lb + 1], row[rb - (Count(1) << level)]));
+            }
+        }
+        return tour[m];
+    }
+
+    size_t bytes() const
+    {
+        return n_nodes * (3 * sizeof(Count) + sizeof(int)) +
+               tour_capacity(n_nodes) * (sizeof(Count) + sizeof(int)) +
+               (size_t)n_levels * n_blocks * sizeof(Count);
+    }
+};
+
+}  // namespace euler
+
+// Returns the checksum of the subtree (the same as traverse()) of a node which caches it,
+// recomputing only the dirty subtrees.
+template <class Node>
+int update_checksum(Node& node)
+{
+    if (!node.dirty) {
+        return node.subtree_checksum;
+    }
+    int checksum = id_checksum(node.node_id);
+    uint64_t hash = hash_combine(0, node.node_id);
+    for (auto& c : node.children) {
+        checksum = (checksum + update_checksum(*c)) % 43112609;
+        hash = hash_combine(hash, c->subtree_hash);
+    }
+    node.subtree_checksum = checksum;
+    node.subtree_hash = hash_combine(hash, node.children.end() - node.children.begin());
+    node.dirty = false;
+    return checksum;
+}
+
+// Marks a node which caches its subtree checksum and its ancestors dirty.
+template <class Node>
+void mark_dirty(Node& node)
+{
+    for (Node* n = &node; n && !n->dirty; n = n->parent) {
+        n->dirty = true;
+    }
+}
+
+template <class Node>
+void set_node_id(Node& node, Count node_id)
+{
+    node.node_id = node_id;
+    mark_dirty(node);
+}
+
+// Changes which turn a region tree of checksum caching nodes into another one. Each change is
+// encoded as the path from the root (child indexes), then either SET_ID and the new node id, or
+// REPLACE and the new subtree (node id and child count of each node, in preorder), which replaces
+// the child at the end of the path. All numbers are varints.
+struct Patch
+{
+    enum Op : uint8_t { SET_ID, REPLACE };
+    vector<uint8_t> bytes;
+    int n_changes = 0;
+
+    void put(uint64_t x) { put_varint(bytes, x); }
+    uint64_t get(size_t& i) const
+    {
+        const uint8_t* p = &bytes[i];
+        uint64_t x = get_varint(p);
+        i = p - bytes.data();
+        return x;
+    }
+};
+
+template <class Node>
+void put_subtree(Patch& patch, const Node& node)
+{
+    patch.put(node.node_id);
+    patch.put(node.children.end() - node.children.begin());
+    for (auto& c : node.children) {
+        put_subtree(patch, *c);
+    }
+}
+
+// Appends the changes from a to b to the patch. Subtrees with the same cached hash are skipped,
+// so the hashes must be up to date (see update_checksum()). A node with a different number of
+// children is replaced, which is not possible at the root.
+template <class Node>
+void diff(const Node& a, const Node& b, vector<int>& path, Patch& patch)
+{
+    if (a.subtree_hash == b.subtree_hash) {
+        return;
+    }
+    auto put_path = [&](Patch::Op op) {
+        patch.put(path.size());
+        for (int i : path) {
+            patch.put(i);
+        }
+        patch.bytes.push_back(op);
+        ++patch.n_changes;
+    };
+    const int n_children = a.children.end() - a.children.begin();
+    if (n_children != b.children.end() - b.children.begin()) {
+        assert(!path.empty());
+        put_path(Patch::REPLACE);
+        put_subtree(patch, b);
+        return;
+    }
+    if (a.node_id != b.node_id) {
+        put_path(Patch::SET_ID);
+        patch.put(b.node_id);
+    }
+    for (int i = 0; i < n_children; ++i) {
+        path.push_back(i);
+        diff(*a.children.begin()[i], *b.children.begin()[i], path, patch);
+        path.pop_back();
+    }
+}
+
+template <class Allocator, class Node>
+Node* get_subtree(Allocator& allocator, const Patch& patch, size_t& i, Node* parent)
+{
+    Count node_id = patch.get(i);
+    int n_children = patch.get(i);
+    Node* node = allocator.template new_object<Node>(allocator, n_children);
+    node->node_id = node_id;
+    node->parent = parent;
+    for (int c = 0; c < n_children; ++c) {
+        node->children.push_back(get_subtree(allocator, patch, i, node));
+    }
+    return node;
+}
+
+// Applies the patch to the tree (in place), new nodes are allocated from allocator. The changed
+// nodes and their ancestors become dirty.
+template <class Allocator, class Node>
+void apply_patch(Allocator& allocator, const Patch& patch, Node& root)
+{
+    for (size_t i = 0; i < patch.bytes.size();) {
+        Node* parent = nullptr;
+        Node* node = &root;
+        int child_index = 0;
+        for (int n = patch.get(i); n > 0; --n) {
+            parent = node;
+            child_index = patch.get(i);
+            node = node->children.begin()[child_index];
+        }
+        if (patch.bytes[i++] == Patch::SET_ID) {
+            set_node_id(*node, patch.get(i));
+        } else {
+            parent->children.begin()[child_index] = get_subtree(allocator, patch, i, parent);
+            mark_dirty(*parent);
+        }
+    }
+}
+
+// Passes over the tree which need only some of the fields of the nodes. The checksum pass reads
+// the node ids, in any order (it gives the same checksum as traverse()), the structure pass only
+// the children (it counts the nodes).
+template <class Node>
+int checksum_pass(const Node& root)
+{
+    return traverse_baseline(root);
+}
+
+// Reads the node ids back from the cold fields (see make_cold_fields()).
+template <bool SplitCold>
+int checksum_pass(const with_payload::Node<SplitCold>& node)
+{
+    const with_payload::ColdFields& cold = node.cold_fields();
+    int checksum = id_checksum((Count)cold.line * 97 + cold.file);
+    for (auto& c : node.children) {
+        checksum = (checksum + checksum_pass(*c)) % 43112609;
+    }
+    return checksum;
+}
+
+int checksum_pass(const soa::Tree& tree)
+{
+    int checksum = 0;
+    for (Count i = 0; i < tree.n_nodes; ++i) {
+        checksum = (checksum + id_checksum(tree.node_id[i])) % 43112609;
+    }
+    return checksum;
+}
+
+template <class Node>
+Count structure_pass(const Node& node)
+{
+    Count n = 1;
+    for (auto& c : node.children) {
+        n += structure_pass(*c);
+    }
+    return n;
+}
+
+int checksum_pass(const dag::Node& root)
+{
+    return traverse_dag(root, 0, 1);
+}
+
+int checksum_pass(const succinct::Tree& tree)
+{
+    int checksum = 0;
+    for (Count i = 0; i < tree.size(); ++i) {
+        checksum = (checksum + id_checksum(tree.node_id(i))) % 43112609;
+    }
+    return checksum;
+}
+
+Count structure_pass(const succinct::Tree& tree)
+{
+    return structure_pass(tree.root());
+}
+
+Count structure_pass(const soa::Tree& tree, Count node = 0)
+{
+    Count n = 1;
+    for (Count c = tree.first_child[node], end = c + tree.n_children[node]; c < end; ++c) {
+        n += structure_pass(tree, c);
+    }
+    return n;
+}
+
+// Fills the CSR arrays from the subtree of node in depth-first order. The children of a node get
+// their slots in tree.children before the first one is visited, so the slots are in node order.
+template <class Node>
+Count freeze_dfs(const Node& node, csr::Tree& tree, Count& next_node, Count& next_slot)
+{
+    const Count i = next_node++;
+    tree.node_id[i] = node.node_id;
+    Count slot = tree.offsets[i] = next_slot;
+    next_slot += node.children.end() - node.children.begin();
+    for (auto& c : node.children) {
+        tree.children[slot++] = freeze_dfs(*c, tree, next_node, next_slot);
+    }
+    return i;
+}
+
+// Makes a CSR snapshot of the tree of root (with_raii or without_raii nodes) in allocator: the
+// first pass counts the nodes, so the arrays can be allocated at their final size, the second
+// one fills them, in order.
+template <class Node>
+csr::Tree freeze(region::Allocator& allocator, const Node& root, csr::Order order)
+{
+    csr::Tree tree(allocator, structure_pass(root));
+    Count next_node = 0, next_slot = 0;
+    if (order == csr::Order::DFS) {
+        freeze_dfs(root, tree, next_node, next_slot);
+    } else {
+        // The nodes in BFS order, which is the order they are numbered in.
+        vector<const Node*> queue(tree.n_nodes);
+        queue[next_node++] = &root;
+        for (Count i = 0; i < tree.n_nodes; ++i) {
+            tree.node_id[i] = queue[i]->node_id;
+            tree.offsets[i] = next_slot;
+            for (auto& c : queue[i]->children) {
+                tree.children[next_slot++] = next_node;
+                queue[next_node++] = &*c;
+            }
+        }
+    }
+    tree.offsets[tree.n_nodes] = next_slot;
+    return tree;
+}
+
+struct Report
+{
+    duration build, traversal, deallocation;
+    int checksum;
+    AllocationStat allocations;
+    duration checksum_pass, structure_pass;  // Not part of the total.
+    long long traversal_cache_misses;        // -1 if the counter is not available.
+
+    duration total() const { return build + traversal + deallocation; }
+};
+
+template <class Allocator, class Node>
+Report test(const char* name, const Config& config)
+{
+    g_stat = AllocationStat{};
+    fprintf(stderr, "-- Testing: %s\n", name);
+    time_point t0, t1, t2, t3, t4, t5, p0, p1, p2;
+    int checksum;
+    PerfCounter cache_misses(PerfCounter::CACHE_MISSES);
+    {
+        Allocator allocator(config.region);
+        auto worker_allocators = make_worker_allocators<Allocator>(config.n_threads, config.region);
+        t0 = hrclock::now();
+        auto r = build_tree<Allocator, Node>(allocator, worker_allocators, config);
+        t1 = hrclock::now();
+        t2 = hrclock::now();
+        cache_misses.start();
+        checksum = traverse(r, config.isa);
+        cache_misses.stop();
+        t3 = hrclock::now();
+        p0 = hrclock::now();
+        int pass_checksum = checksum_pass(r);
+        p1 = hrclock::now();
+        Count n_nodes = structure_pass(r);
+        p2 = hrclock::now();
+        if (pass_checksum != checksum || n_nodes != g_stat.n_nodes_created) {
+            fprintf(stderr, "Internal error, the passes don't agree with the traversal.\n");
+            std::terminate();
+        }
+        t4 = hrclock::now();
+    }
+    t5 = hrclock::now();
+    if (g_trace.enabled()) {
+        g_trace.span("build", "phase", t0, t1);
+        g_trace.span("traversal", "phase", t2, t3);
+        g_trace.span("deallocation", "phase", t4, t5);
+        g_trace.span(name, "strategy", t0, t5);
+        g_trace.sample_counters();
+    }
+    return Report{t1 - t0, t3 - t2, t5 - t4, checksum, g_stat, p1 - p0, p2 - p1,
+                  cache_misses.value()};
+}
+
+void check_same_tree(const Report& a, const Report& b)
+{
+    if (a.allocations.n_nodes_created != b.allocations.n_nodes_created ||
+        a.checksum != b.checksum) {
+        fprintf(stderr, "Internal error, different checksum or number of nodes created.\n");
+        std::terminate();
+    }
+}
+
+// A way of storing the tree which can be benchmarked by compare().
+struct Strategy
+{
+    const char* name;  // Used in --strategies.
+    const char* title;
+    const char* description;
+    Report (*run)(const char* title, const Config& config);
+    // If set, the strategy runs in a child process with GLIBC_TUNABLES set to this, since glibc
+    // reads its tunables only at startup.
+    const char* glibc_tunables;
+
+    // The glibc strategies need glibc malloc.
+    bool available() const { return !glibc_tunables || strcmp(MALLOC, "glibc") == 0; }
+};
+
+const Strategy STRATEGIES[] = {
+    {"region", "Region",
+     "Region-style allocator: all memory is allocated from a local pool (region) and\n"
+     "   deallocated at once when the region goes out of scope.",
+     &test<without_raii::Allocator, without_raii::Node>, nullptr},
+    {"raii", "RAII",
+     "The usual, RAII-style storage (node holds a vector of owning pointers\n   to the children)",
+     &test<with_raii::Allocator, with_raii::Node>, nullptr},
+    {"pmr-monotonic", "pmr monotonic",
+     "RAII-style nodes allocated from a std::pmr::monotonic_buffer_resource (freeing a\n"
+     "   node is a no-op, the memory is released with the resource)",
+     &test<with_pmr::Allocator<std::pmr::monotonic_buffer_resource>, with_pmr::Node>, nullptr},
+    {"pmr-pool", "pmr pool",
+     "RAII-style nodes allocated from a std::pmr::unsynchronized_pool_resource",
+     &test<with_pmr::Allocator<std::pmr::unsynchronized_pool_resource>, with_pmr::Node>, nullptr},
+    {"pmr-sync-pool", "pmr sync pool",
+     "RAII-style nodes allocated from a std::pmr::synchronized_pool_resource",
+     &test<with_pmr::Allocator<std::pmr::synchronized_pool_resource>, with_pmr::Node>, nullptr},
+    {"soa", "SoA",
+     "Structure-of-arrays tree in a region: node ids, first child indexes and child counts\n"
+     "   in separate arrays, built and freed as a whole",
+     &test<region::Allocator, soa::Tree>, nullptr},
+    {"region-dag", "region DAG",
+     "Region-style allocator, identical subtrees are built only once (hash-consing), the\n"
+     "   node ids are reconstructed by the traversal",
+     &test<region::Allocator, dag::Node>, nullptr},
+    {"succinct", "succinct",
+     "LOUDS tree in a region: the structure in 2 bits per node with rank/select\n"
+     "   indexes, the node ids in a bit-packed array, traversed through node views",
+     &test<region::Allocator, succinct::Tree>, nullptr},
+    {"payload", "payload",
+     "Region-style allocator, nodes with a 32-byte payload of cold fields (source location,\n"
+     "   name) stored in the node",
+     &test<with_payload::Allocator, with_payload::Node<false>>, nullptr},
+    {"payload-split", "split payload",
+     "Like payload, but the cold fields are in a separate region stream, the node has a\n"
+     "   pointer to them only",
+     &test<with_payload::Allocator, with_payload::Node<true>>, nullptr},
+    {"glibc-no-tcache", "no tcache", "RAII-style storage, glibc malloc without the thread cache",
+     &test<with_raii::Allocator, with_raii::Node>, "glibc.malloc.tcache_count=0"},
+    {"glibc-big-tcache", "big tcache",
+     "RAII-style storage, glibc malloc caching up to 1024 blocks/size in the thread cache",
+     &test<with_raii::Allocator, with_raii::Node>, "glibc.malloc.tcache_count=1024"},
+    {"glibc-one-arena", "one arena", "RAII-style storage, glibc malloc with a single arena",
+     &test<with_raii::Allocator, with_raii::Node>, "glibc.malloc.arena_max=1"},
+    {"glibc-no-trim", "no trim",
+     "RAII-style storage, glibc malloc never returning freed memory to the system",
+     &test<with_raii::Allocator, with_raii::Node>,
+     "glibc.malloc.trim_threshold=4294967295:glibc.malloc.mmap_threshold=4294967295"},
+    {"glibc-mmap-pages", "mmap pages",
+     "Region-style allocator, glibc malloc serving each page with a separate mmap",
+     &test<without_raii::Allocator, without_raii::Node>, "glibc.malloc.mmap_threshold=4096"},
+};
+
+const Strategy* find_strategy(const char* name, size_t length)
+{
+    for (auto& s : STRATEGIES) {
+        if (s.available() && strlen(s.name) == length && strncmp(s.name, name, length) == 0) {
+            return &s;
+        }
+    }
+    return nullptr;
+}
+
+// Parses a comma-separated list of strategy names or "all".
+bool parse_strategies(const char* s, vector<const Strategy*>& result)
+{
+    result.clear();
+    if (strcmp(s, "all") == 0) {
+        for (auto& x : STRATEGIES) {
+            if (x.available()) {
+                result.push_back(&x);
+            }
+        }
+        return true;
+    }
+    for (;;) {
+        const char* end = strchr(s, ',');
+        size_t length = end ? end - s : strlen(s);
+        auto strategy = find_strategy(s, length);
+        if (!strategy) {
+            return false;
+        }
+        result.push_back(strategy);
+        if (!end) {
+            return true;
+        }
+        s = end + 1;
+    }
+}
+
+// Arguments which make another instance of this program build the same tree.
+std::string config_arguments(const Config& config)
+{
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer),
+             "--depth=%d --children=%d --page-size=%zu --small-block-size=%zu --threads=%d "
+             "--isa=%s",
+             config.tree_depth, config.n_children, config.region.page_size,
+             config.region.max_small_block_size, config.n_threads, ISA_NAMES[(int)config.isa]);
+    std::string arguments = buffer;
+    if (config.region.file_directory) {
+        arguments += std::string(" '--file-backed=") + config.region.file_directory + "'";
+    }
+    return arguments;
+}
+
+// Prints the report in the format read by run_in_child_process().
+void print_raw_report(const Report& r)
+{
+    auto ns = [](duration d) { return (long long)std::chrono::nanoseconds(d).count(); };
+    printf("%lld %lld %lld %d %lld %zu %lld %lld %lld %lld %lld\n", ns(r.build), ns(r.traversal),
+           ns(r.deallocation), r.checksum, (long long)r.allocations.n_nodes_created,
+           r.allocations.total_bytes_allocated, (long long)r.allocations.n_allocations,
+           (long long)r.allocations.n_frees, ns(r.checksum_pass), ns(r.structure_pass),
+           r.traversal_cache_misses);
+}
+
+// Runs the strategy in a new instance of this program (see --report) with the strategy's
+// GLIBC_TUNABLES in the environment.
+Report run_in_child_process(const Strategy& s, const Config& config)
+{
+#if defined(__GLIBC__) && defined(__linux__)
+    char exe[4096];
+    ssize_t length = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (length > 0) {
+        exe[length] = 0;
+        std::string command = std::string("GLIBC_TUNABLES=") + s.glibc_tunables + " '" + exe +
+                              "' --report=" + s.name + " " + config_arguments(config);
+        if (FILE* child = popen(command.c_str(), "r")) {
+            long long build, traversal, deallocation, checksum_pass, structure_pass;
+            long long n_nodes_created, n_allocations, n_frees;
+            Report r;
+            int n = fscanf(child, "%lld %lld %lld %d %lld %zu %lld %lld %lld %lld %lld", &build,
+                           &traversal, &deallocation, &r.checksum, &n_nodes_created,
+                           &r.allocations.total_bytes_allocated, &n_allocations, &n_frees,
+                           &checksum_pass, &structure_pass, &r.traversal_cache_misses);
+            if (pclose(child) == 0 && n == 11) {
+                r.allocations.n_nodes_created = n_nodes_created;
+                r.allocations.n_allocations = n_allocations;
+                r.allocations.n_frees = n_frees;
+                r.build = std::chrono::nanoseconds(build);
+                r.traversal = std::chrono::nanoseconds(traversal);
+                r.deallocation = std::chrono::nanoseconds(deallocation);
+                r.checksum_pass = std::chrono::nanoseconds(checksum_pass);
+                r.structure_pass = std::chrono::nanoseconds(structure_pass);
+                return r;
+            }
+        }
+    }
+    fprintf(stderr, "Running %s in a child process failed.\n", s.name);
+#else
+    fprintf(stderr, "%s needs glibc on Linux.\n", s.name);
+#endif
+    std::terminate();
+}
+
+// Runs each strategy once with the given configuration and prints the comparison, relative to
+// the region strategy if it's among them, otherwise to the first one.
+void compare(const vector<const Strategy*>& strategies, const Config& config)
+{
+    fprintf(stderr, "Benchmarking the building, traversal and deallocation of a tree using:\n\n");
+    for (size_t i = 0; i < strategies.size(); ++i) {
+        fprintf(stderr, "%zu. %s\n", i + 1, strategies[i]->description);
+        if (strategies[i]->glibc_tunables) {
+            fprintf(stderr, "   (GLIBC_TUNABLES=%s)\n", strategies[i]->glibc_tunables);
+        }
+    }
+    fprintf(stderr, "\n");
+    vector<Report> reports;
+    size_t baseline = 0;
+    for (auto s : strategies) {
+        if (s->run == STRATEGIES[0].run && !s->glibc_tunables) {
+            baseline = reports.size();
+        }
+        reports.push_back(s->glibc_tunables ? run_in_child_process(*s, config)
+                                            : s->run(s->title, config));
+        check_same_tree(reports[0], reports.back());
+    }
+    fprintf(stderr, "\n");
+
+    fprintf(stderr, "Tree node count: %lld (%d levels, %d children/node, %d thread(s))\n",
+            (long long)reports[0].allocations.n_nodes_created, config.tree_depth, config.n_children,
+            config.n_threads);
+    fprintf(stderr, "malloc: %s, build: %s, traversal: %s\n\n", MALLOC, BUILD,
+            ISA_NAMES[(int)config.isa]);
+    // Prints a row of the table, cell(i) is the text in the column of strategies[i].
+    auto print_row = [&](const char* label, std::function<std::string(size_t)> cell) {
+        fprintf(stderr, "%19s", label);
+        for (size_t i = 0; i < reports.size(); ++i) {
+            fprintf(stderr, "%s%16s", i == 0 ? " " : " | ", cell(i).c_str());
+        }
+        fprintf(stderr, "\n");
+    };
+    auto format = [](const char* f, auto... args) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), f, args...);
+        return std::string(buffer);
+    };
+    auto time_row = [&](const char* label, std::function<duration(const Report&)> time) {
+        auto sec = [&](size_t i) { return ddur(time(reports[i])).count(); };
+        print_row(label, [&](size_t i) {
+            return format("%6.3fs (%4.0f%%)", sec(i), 100.0 * sec(i) / sec(baseline));
+        });
+    };
+    print_row("", [&](size_t i) { return std::string(strategies[i]->title); });
+    print_row("", [](size_t) { return std::string(16, '-'); });
+    time_row("Build time:", [](const Report& r) { return r.build; });
+    time_row("Traversal time:", [](const Report& r) { return r.traversal; });
+    time_row("Deallocation time:", [](const Report& r) { return r.deallocation; });
+    time_row("Total time:", [](const Report& r) { return r.total(); });
+    time_row("Checksum pass:", [](const Report& r) { return r.checksum_pass; });
+    time_row("Structure pass:", [](const Report& r) { return r.structure_pass; });
+    print_row("Cache misses/node:", [&](size_t i) {
+        const Report& r = reports[i];
+        return r.traversal_cache_misses < 0
+                   ? std::string("n/a  ")
+                   : format("%12.3f  ", (double)r.traversal_cache_misses /
+                                            r.allocations.n_nodes_created);
+    });
+    print_row("Heap allocations:", [&](size_t i) {
+        return format("%12lld  ", (long long)reports[i].allocations.n_allocations);
+    });
+    print_row("Heap deallocations:", [&](size_t i) {
+        return format("%12lld  ", (long long)reports[i].allocations.n_frees);
+    });
+    print_row("Bytes allocated:", [&](size_t i) {
+        return format("%12.3fMB", reports[i].allocations.total_bytes_allocated / 1e6);
+    });
+    print_row("Bytes/node:", [&](size_t i) {
+        const AllocationStat& a = reports[i].allocations;
+        return format("%12.2f  ", (double)a.total_bytes_allocated / a.n_nodes_created);
+    });
+}
+
+// Parameter values tried by --sweep and --autotune.
+struct Grid
+{
+    vector<long long> depths{4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24};
+    vector<long long> fanouts{2, 3, 4, 8};
+    vector<long long> page_sizes{4096, 16384, 65536, 262144, 1048576};
+    vector<long long> small_block_sizes{256, 1024, 4096, 16384};  // Only for --autotune.
+    vector<long long> thread_counts;
+    double mem_limit_mb;  // Shapes whose estimated memory use exceeds this are skipped.
+    bool csv = false;
+    int repetitions = 3;  // --autotune keeps the best of this many runs of each candidate.
+
+    Grid()
+    {
+        thread_counts.push_back(1);
+        long long n_cores = std::thread::hardware_concurrency();
+        if (n_cores > 1) {
+            thread_counts.push_back(n_cores);
+        }
+        mem_limit_mb = 1024;
+#if defined(__linux__)
+        mem_limit_mb = sysconf(_SC_PHYS_PAGES) * (double)sysconf(_SC_PAGESIZE) / 2e6;
+#endif
+    }
+};
+
+// Prints one row of the sweep results: the per-node costs of a strategy.
+void print_sweep_row(const Grid& sweep,
+                     const char* strategy,
+                     const Config& config,
+                     const char* page_size,
+                     const Report& r)
+{
+    double n = r.allocations.n_nodes_created;
+    auto ns = [n](duration d) { return std::chrono::duration<double, std::nano>(d).count() / n; };
+    const char* format = sweep.csv ? "%s,%s,%d,%d,%lld,%s,%d,%.2f,%.2f,%.2f,%.2f,%.1f\n"
+                                   : "%-8s %-8s %5d %6d %10lld %9s %7d %9.2f %9.2f %9.2f %9.2f "
+                                     "%10.1f\n";
+    printf(format, MALLOC, strategy, config.tree_depth, config.n_children,
+           (long long)r.allocations.n_nodes_created, page_size, config.n_threads, ns(r.build),
+           ns(r.traversal), ns(r.deallocation), ns(r.total()),
+           r.allocations.total_bytes_allocated / n);
+    fflush(stdout);
+}
+
+// Runs both strategies for each configuration of the grid, from the smallest tree to the largest,
+// and prints the per-node costs. The depths of a fanout are abandoned at the first tree which
+// would not fit into the memory limit (estimated from the previous, smaller trees).
+void sweep(const Grid& sweep)
+{
+    printf(sweep.csv ? "malloc,strategy,depth,fanout,nodes,page_size,threads,build_ns_per_node,"
+                       "traversal_ns_per_node,deallocation_ns_per_node,total_ns_per_node,"
+                       "bytes_per_node\n"
+                     : "malloc   strategy depth fanout      nodes page_size threads  build_ns "
+                       "traver_ns dealloc_ns total_ns bytes/node\n");
+    for (auto fanout : sweep.fanouts) {
+        // Heap bytes per node of the RAII tree, which is the bigger one (the region tree doesn't
+        // pay the malloc overhead). Initial guess for a node, its children vector and the
+        // bookkeeping of malloc, updated after each run.
+        double bytes_per_node = 64 + 8.0 * fanout;
+        for (auto depth : sweep.depths) {
+            long long n_nodes = 1 + n_descendants(fanout, depth);
+            double max_page_size =
+                *std::max_element(sweep.page_sizes.begin(), sweep.page_sizes.end());
+            double estimated_mb = (1.5 * bytes_per_node * n_nodes + max_page_size) / 1e6;
+            if (n_nodes > MAX_NODES || estimated_mb > sweep.mem_limit_mb) {
+                fprintf(stderr,
+                        "-- Stopping at depth %lld, fanout %lld: %lld nodes, estimated %.0fMB "
+                        "(limit: %.0fMB, %lld nodes)\n",
+                        depth, fanout, n_nodes, estimated_mb, sweep.mem_limit_mb, MAX_NODES);
+                break;
+            }
+            for (auto n_threads : sweep.thread_counts) {
+                Config config;
+                config.tree_depth = depth;
+                config.n_children = fanout;
+                config.n_threads = n_threads;
+                auto raii = test<with_raii::Allocator, with_raii::Node>("RAII-allocator", config);
+                print_sweep_row(sweep, "RAII", config, "-", raii);
+                bytes_per_node = std::max(
+                    bytes_per_node, (double)raii.allocations.total_bytes_allocated / n_nodes);
+                for (auto page_size : sweep.page_sizes) {
+                    config.region.page_size = page_size;
+                    auto region = test<without_raii::Allocator, without_raii::Node>(
+                        "Region-allocator", config);
+                    check_same_tree(region, raii);
+                    print_sweep_row(sweep, "Region", config, std::to_string(page_size).c_str(),
+                                    region);
+                }
+            }
+        }
+    }
+}
+
+// Runs the region strategy on the configured tree with each valid combination of the page sizes
+// and small block thresholds of the grid, and prints the best one.
+void autotune(Config config, const Grid& grid)
+{
+    struct Candidate
+    {
+        region::Params params;
+        Report report;
+    };
+    vector<Candidate> candidates;
+    auto sec = [](duration d) { return ddur(d).count(); };
+    fprintf(stderr,
+            "Autotuning the region allocator on a tree of %d levels, %d children/node, %d "
+            "thread(s), best of %d run(s), malloc: %s.\n",
+            config.tree_depth, config.n_children, config.n_threads, grid.repetitions, MALLOC);
+    printf("page_size small_block    build traversal  dealloc    total\n");
+    for (auto page_size : grid.page_sizes) {
+        for (auto small_block_size : grid.small_block_sizes) {
+            config.region.page_size = page_size;
+            config.region.max_small_block_size = small_block_size;
+            if (!config.region.valid()) {
+                continue;
+            }
+            Candidate c{config.region, {}};
+            for (int i = 0; i < grid.repetitions; ++i) {
+                auto r = test<without_raii::Allocator, without_raii::Node>("Region-allocator",
+                                                                           config);
+                if (i == 0 || r.total() < c.report.total()) {
+                    c.report = r;
+                }
+            }
+            printf("%9lld %11lld %8.3f %9.3f %8.3f %8.3f\n", page_size, small_block_size,
+                   sec(c.report.build), sec(c.report.traversal), sec(c.report.deallocation),
+                   sec(c.report.total()));
+            fflush(stdout);
+            candidates.push_back(c);
+        }
+    }
+    if (candidates.empty()) {
+        fprintf(stderr, "No valid combination of page size and small block threshold.\n");
+        return;
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.report.total() < b.report.total();
+    });
+    auto& best = candidates[0];
+    printf("\nBest: page size %zu, small block threshold %zu, total %.3fs\n",
+           best.params.page_size, best.params.max_small_block_size, sec(best.report.total()));
+    auto print_margin = [&](const char* name, const Candidate& c) {
+        printf("      %.1f%% faster than the %s (page size %zu, small block threshold %zu)\n",
+               100.0 * (sec(c.report.total()) / sec(best.report.total()) - 1), name,
+               c.params.page_size, c.params.max_small_block_size);
+    };
+    if (candidates.size() > 1) {
+        print_margin("runner-up", candidates[1]);
+    }
+    region::Params defaults;
+    for (auto& c : candidates) {
+        if (c.params.page_size == defaults.page_size &&
+            c.params.max_small_block_size == defaults.max_small_block_size) {
+            print_margin("default", c);
+        }
+    }
+}
+
+// Parses a comma-separated list of positive integers.
+bool parse_list(const char* s, vector<long long>& result)
+{
+    result.clear();
+    for (;;) {
+        char* end;
+        long long x = strtoll(s, &end, 10);
+        if (end == s || x <= 0) {
+            return false;
+        }
+        result.push_back(x);
+        if (*end == 0) {
+            return true;
+        }
+        if (*end != ',') {
+            return false;
+        }
+        s = end + 1;
+    }
+}
+
+// If arg is `name=value`, sets value and returns true.
+bool match_option(const char* arg, const char* name, const char*& value)
+{
+    size_t n = strlen(name);
+    if (strncmp(arg, name, n) != 0 || arg[n] != '=') {
+        return false;
+    }
+    value = arg + n + 1;
+    return true;
+}
+
+// Walks n_paths random root-to-leaf paths (the same ones for each tree shape), children(node)
+// returning the children of a node. Returns the number of nodes visited.
+template <class Node, class Children>
+long long visit_paths(Node& root, int n_paths, Children children)
+{
+    std::mt19937 random(12345);
+    long long n_visited = 0;
+    for (int i = 0; i < n_paths; ++i) {
+        for (Node* node = &root; node;) {
+            ++n_visited;
+            auto& c = children(*node);
+            size_t n = c.end() - c.begin();
+            node = n ? &**(c.begin() + random() % n) : nullptr;
+        }
+    }
+    return n_visited;
+}
+
+// Visits n_paths random root-to-leaf paths of the configured tree, first building the whole tree
+// (if it fits into the memory limit), then building the nodes on the paths only, on demand, and
+// prints the time and memory of both.
+void lazy_paths(const Config& config, const Grid& grid, int n_paths)
+{
+    struct Result
+    {
+        duration build, query;
+        AllocationStat allocations;
+        long long n_visited;
+    };
+    vector<std::pair<const char*, Result>> results;
+    double n_nodes = 1, level_size = 1;  // Might not fit into an integer.
+    for (int i = 0; i < config.tree_depth; ++i) {
+        level_size *= config.n_children;
+        n_nodes += level_size;
+    }
+    double estimated_mb = 1.5 * (64 + 8.0 * config.n_children) * n_nodes / 1e6;
+    fprintf(stderr, "Visiting %d random root-to-leaf paths of a tree of %.0f nodes (%d levels, %d "
+            "children/node)\n\n", n_paths, n_nodes, config.tree_depth, config.n_children);
+
+    if (n_nodes <= MAX_NODES && estimated_mb <= grid.mem_limit_mb) {
+        fprintf(stderr, "-- Testing: eager\n");
+        Result r;
+        auto t0 = hrclock::now();
+        BuiltTree<region::Allocator, without_raii::Node> tree(config);
+        auto t1 = hrclock::now();
+        r.n_visited = visit_paths(tree.root, n_paths,
+                                  [](without_raii::Node& n) -> auto& { return n.children; });
+        auto t2 = hrclock::now();
+        r.build = t1 - t0;
+        r.query = t2 - t1;
+        r.allocations = g_stat;
+        results.emplace_back("eager", r);
+    } else {
+        fprintf(stderr, "-- Skipping eager: estimated %.0fMB (limit: %.0fMB, %lld nodes)\n",
+                estimated_mb, grid.mem_limit_mb, MAX_NODES);
+    }
+
+    fprintf(stderr, "-- Testing: lazy\n");
+    g_stat = AllocationStat{};
+    Result r;
+    region::Allocator allocator(config.region);
+    auto t0 = hrclock::now();
+    lazy::Node root(allocator, config.n_children, config.tree_depth);
+    auto t1 = hrclock::now();
+    r.n_visited = visit_paths(root, n_paths, [&](lazy::Node& n) -> auto& {
+        return n.get_children(allocator, config.n_children);
+    });
+    auto t2 = hrclock::now();
+    r.build = t1 - t0;
+    r.query = t2 - t1;
+    r.allocations = g_stat;
+    results.emplace_back("lazy", r);
+    if (results.size() == 2 && results[0].second.n_visited != r.n_visited) {
+        fprintf(stderr, "Internal error, different number of nodes visited.\n");
+        std::terminate();
+    }
+
+    auto sec = [](duration d) { return ddur(d).count(); };
+    fprintf(stderr, "\n%19s", "");
+    for (auto& x : results) {
+        fprintf(stderr, " %14s", x.first);
+    }
+    fprintf(stderr, "\n");
+    auto row = [&](const char* label, const char* format, auto value) {
+        fprintf(stderr, "%19s", label);
+        for (auto& x : results) {
+            fprintf(stderr, format, value(x.second));
+        }
+        fprintf(stderr, "\n");
+    };
+    row("Build time:", " %13.6fs", [&](const Result& r) { return sec(r.build); });
+    row("Query time:", " %13.6fs", [&](const Result& r) { return sec(r.query); });
+    row("Total time:", " %13.6fs", [&](const Result& r) { return sec(r.build + r.query); });
+    row("Nodes visited:", " %14lld", [](const Result& r) { return r.n_visited; });
+    row("Nodes built:", " %14lld",
+        [](const Result& r) { return (long long)r.allocations.n_nodes_created; });
+    row("Bytes allocated:", " %12.3fMB",
+        [](const Result& r) { return r.allocations.total_bytes_allocated / 1e6; });
+}
+
+// Visits n_paths root-to-leaf paths, picking the first child with probability 3/4, the second one
+// with 3/16 and so on, so a few subtrees get most of the visits.
+template <class Node, class Children>
+long long visit_skewed_paths(Node& root, int n_paths, std::mt19937& random, Children children)
+{
+    long long n_visited = 0;
+    for (int i = 0; i < n_paths; ++i) {
+        for (Node* node = &root; node;) {
+            ++n_visited;
+            auto& c = children(*node);
+            size_t n = c.end() - c.begin(), child = 0;
+            while (child + 1 < n && random() % 4 == 0) {
+                ++child;
+            }
+            node = n ? &**(c.begin() + child) : nullptr;
+        }
+    }
+    return n_visited;
+}
+
+// Builds the configured tree, and a copy of it with the subtrees of cold_levels levels packed
+// (see cold::Node), then runs rounds of skewed path queries on both and prints the query times,
+// how many packed subtrees the queries expanded and the memory of the copy to stdout.
+void cold_subtrees(const Config& config, int cold_levels)
+{
+    const int n_paths = 10000, n_rounds = 4;
+    BuiltTree<region::Allocator, without_raii::Node> tree(config);
+    auto& root = tree.root;
+    const double eager_mb = g_stat.total_bytes_allocated / 1e6;
+
+    vector<uint8_t> buffer;
+    buffer.reserve(16 * n_descendants(config.n_children, std::min(cold_levels, config.tree_depth)));
+    const size_t bytes_before = g_stat.total_bytes_allocated;
+    region::Allocator packed_allocator(config.region);
+    auto t0 = hrclock::now();
+    cold::Node* packed_root = cold::Node::pack(packed_allocator, root,
+                                               std::max(0, config.tree_depth - cold_levels),
+                                               config.n_children, buffer);
+    auto t1 = hrclock::now();
+    auto packed_mb = [&] { return (g_stat.total_bytes_allocated - bytes_before) / 1e6; };
+    fprintf(stderr, "Tree: %.3fMB, packed in %.3fms: %.3fMB\n", eager_mb, ms(t1 - t0),
+            packed_mb());
+
+    printf("round  paths   tree_ms packed_ms  expanded  packed_mb\n");
+    std::mt19937 tree_random(12345), packed_random(12345);
+    long long n_expanded = 0;
+    for (int round = 1; round <= n_rounds; ++round) {
+        auto t0 = hrclock::now();
+        long long n_visited = visit_skewed_paths(root, n_paths, tree_random,
+                                                 [](without_raii::Node& n) -> auto& {
+            return n.children;
+        });
+        auto t1 = hrclock::now();
+        long long n_packed_visited =
+            visit_skewed_paths(*packed_root, n_paths, packed_random, [&](cold::Node& n) -> auto& {
+                n_expanded += n.expand(packed_allocator, config.n_children);
+                return n.children;
+            });
+        auto t2 = hrclock::now();
+        if (n_visited != n_packed_visited) {
+            fprintf(stderr, "Internal error, different number of nodes visited.\n");
+            std::terminate();
+        }
+        printf("%5d %6d %9.3f %9.3f %9lld %10.3f\n", round, n_paths, ms(t1 - t0), ms(t2 - t1),
+               n_expanded, packed_mb());
+        fflush(stdout);
+    }
+}
+
+// Builds the configured tree of checksum caching nodes, then for each batch size changes the ids
+// of that many random nodes and recomputes the checksum with a full traversal and incrementally,
+// and prints the times to stdout.
+template <class Allocator, class Node>
+void incremental_test(const char* name, const Config& config, const vector<long long>& batches)
+{
+    fprintf(stderr, "-- Testing: %s\n", name);
+    BuiltTree<Allocator, Node> tree(config);
+    auto& root = tree.root;
+    vector<Node*> nodes;
+    for (int level = 0; level <= config.tree_depth; ++level) {
+        collect_level(root, level, nodes);
+    }
+    auto t0 = hrclock::now();
+    update_checksum(root);
+    auto t1 = hrclock::now();
+    fprintf(stderr, "   first checksum: %.6fs\n", ddur(t1 - t0).count());
+
+    std::mt19937 random(12345);
+    for (auto batch : batches) {
+        auto t0 = hrclock::now();
+        for (long long i = 0; i < batch; ++i) {
+            set_node_id(*nodes[random() % nodes.size()], random() % 43112609);
+        }
+        auto t1 = hrclock::now();
+        int full = traverse_baseline(root);
+        auto t2 = hrclock::now();
+        int incremental = update_checksum(root);
+        auto t3 = hrclock::now();
+        if (full != incremental) {
+            fprintf(stderr, "Internal error, different full and incremental checksum.\n");
+            std::terminate();
+        }
+        printf("%-8s %10lld %10.3f %10.3f %10.3f %8.1fx\n", name, batch, ms(t1 - t0), ms(t2 - t1),
+               ms(t3 - t2), ms(t2 - t1) / ms(t3 - t2));
+        fflush(stdout);
+    }
+}
+
+// Runs incremental_test() with the region and the RAII tree.
+void incremental(const Config& config, const vector<long long>& batches)
+{
+    printf("strategy      batch    edit_ms    full_ms    incr_ms  speedup\n");
+    incremental_test<without_raii::Allocator, without_raii::BasicNode<true>>("Region", config,
+                                                                              batches);
+    incremental_test<with_raii::Allocator, with_raii::BasicNode<true>>("RAII", config, batches);
+}
+
+// Builds two region trees of the configured shape, a and b, for each change rate changes that
+// fraction of the nodes of b (mostly their ids, every 64th change replaces a subtree with a leaf),
+// and compares rebuilding b from scratch with patching a: the diff between a and b (after
+// updating the hashes of b) and the application of the patch.
+void diff_patch(const Config& config)
+{
+    using Node = without_raii::BasicNode<true>;
+    printf("  change%%    changes patch_bytes rebuild_ms    hash_ms    diff_ms   apply_ms\n");
+    for (double rate : {0.0001, 0.001, 0.01, 0.1}) {
+        BuiltTree<region::Allocator, Node> a(config);
+        update_checksum(a.root);
+        auto t0 = hrclock::now();
+        BuiltTree<region::Allocator, Node> b(config);
+        auto t1 = hrclock::now();
+        const Count n_nodes = g_stat.n_nodes_created;
+
+        vector<Node*> nodes;
+        for (int level = 0; level <= config.tree_depth; ++level) {
+            collect_level(b.root, level, nodes);
+        }
+        std::mt19937 random(12345);
+        const Count n_changes = std::max<Count>(1, rate * n_nodes);
+        for (Count i = 0; i < n_changes; ++i) {
+            Node* node = nodes[1 + random() % (nodes.size() - 1)];
+            if (i % 64 != 63) {
+                set_node_id(*node, random() % 43112609);
+                continue;
+            }
+            Node* leaf = b.allocator.new_object<Node>(b.allocator, config.n_children);
+            leaf->parent = node->parent;
+            for (auto& c : node->parent->children) {
+                c = c == node ? leaf : c;
+            }
+            mark_dirty(*leaf);
+        }
+
+        auto t2 = hrclock::now();
+        int b_checksum = update_checksum(b.root);
+        auto t3 = hrclock::now();
+        Patch patch;
+        vector<int> path;
+        diff(a.root, b.root, path, patch);
+        auto t4 = hrclock::now();
+        apply_patch(a.allocator, patch, a.root);
+        auto t5 = hrclock::now();
+        if (update_checksum(a.root) != b_checksum ||
+            a.root.subtree_hash != b.root.subtree_hash) {
+            fprintf(stderr, "Internal error, the patched tree differs from the new one.\n");
+            std::terminate();
+        }
+        printf("%8.2f%% %10d %11zu %10.3f %10.3f %10.3f %10.3f\n", rate * 100, patch.n_changes,
+               patch.bytes.size(), ms(t1 - t0), ms(t3 - t2), ms(t4 - t3), ms(t5 - t4));
+        fflush(stdout);
+    }
+}
+
+// Builds the configured tree, freezes it into CSR in both orders and prints how long that takes,
+// the traversal times of the tree and the snapshot and after how many traversals the snapshot
+// pays for itself.
+template <class Allocator, class Node>
+void freeze_test(const char* name, const Config& config)
+{
+    fprintf(stderr, "-- Testing: %s\n", name);
+    BuiltTree<Allocator, Node> built(config);
+    auto& root = built.root;
+    auto t0 = hrclock::now();
+    int checksum = traverse(root, config.isa);
+    auto t1 = hrclock::now();
+    for (auto order : {csr::Order::BFS, csr::Order::DFS}) {
+        region::Allocator csr_allocator(config.region);
+        auto t2 = hrclock::now();
+        csr::Tree tree = freeze(csr_allocator, root, order);
+        auto t3 = hrclock::now();
+        int csr_checksum = traverse(tree, config.isa);
+        auto t4 = hrclock::now();
+        if (csr_checksum != checksum) {
+            fprintf(stderr, "Internal error, the snapshot differs from the tree.\n");
+            std::terminate();
+        }
+        double saved = ms(t1 - t0) - ms(t4 - t3);
+        printf("%-8s %-5s %10.3f %10.3f %10.3f %10.2f ", name,
+               order == csr::Order::BFS ? "bfs" : "dfs", ms(t3 - t2), ms(t1 - t0), ms(t4 - t3),
+               (double)tree.bytes() / tree.n_nodes);
+        if (saved > 0) {
+            printf("%10.1f\n", ms(t3 - t2) / saved);
+        } else {
+            printf("%10s\n", "never");
+        }
+        fflush(stdout);
+    }
+}
+
+// Runs freeze_test() with the region and the RAII tree.
+void freeze_benchmark(const Config& config)
+{
+    printf("strategy order  freeze_ms    tree_ms     csr_ms bytes/node break_even\n");
+    freeze_test<without_raii::Allocator, without_raii::Node>("Region", config);
+    freeze_test<with_raii::Allocator, with_raii::Node>("RAII", config);
+}
+
+// Runs the visitors over the tree of root one by one, then fused into a single pass, and prints
+// the times to stdout.
+template <class Node, class... Visitors>
+void fused_row(const char* name, const Node& root, Visitors... visitors)
+{
+    auto t0 = hrclock::now();
+    std::tuple<Visitors...> separate{std::get<0>(visit(root, visitors))...};
+    auto t1 = hrclock::now();
+    std::tuple<Visitors...> fused = visit(root, visitors...);
+    auto t2 = hrclock::now();
+    auto results = [](const auto&... v) { return vector<long long>{v.result()...}; };
+    if (std::apply(results, separate) != std::apply(results, fused)) {
+        fprintf(stderr, "Internal error, the fused visitors differ from the separate ones.\n");
+        std::terminate();
+    }
+    printf("%-8s %2zu %12.3f %10.3f %8.2fx\n", name, sizeof...(Visitors), ms(t1 - t0),
+           ms(t2 - t1), ms(t1 - t0) / ms(t2 - t1));
+    fflush(stdout);
+}
+
+// Builds the configured tree and runs 1 to 4 visitors over it, separately and fused.
+template <class Allocator, class Node>
+void fused_test(const char* name, const Config& config)
+{
+    fprintf(stderr, "-- Testing: %s\n", name);
+    BuiltTree<Allocator, Node> tree(config);
+    auto& root = tree.root;
+    if (std::get<0>(visit(root, ChecksumVisitor{})).checksum != traverse(root, config.isa)) {
+        fprintf(stderr, "Internal error, the visitor differs from the traversal.\n");
+        std::terminate();
+    }
+    fused_row(name, root, ChecksumVisitor{});
+    fused_row(name, root, ChecksumVisitor{}, CountVisitor{});
+    fused_row(name, root, ChecksumVisitor{}, CountVisitor{}, DepthVisitor{});
+    fused_row(name, root, ChecksumVisitor{}, CountVisitor{}, DepthVisitor{}, LeafVisitor{});
+}
+
+void fused(const Config& config)
+{
+    printf("strategy  k  separate_ms   fused_ms  speedup\n");
+    fused_test<without_raii::Allocator, without_raii::Node>("Region", config);
+    fused_test<with_raii::Allocator, with_raii::Node>("RAII", config);
+}
+
+// Builds the configured tree and traverses it with traverse() and traverse_interleaved() with
+// different group sizes, and prints the nodes per second of each to stdout. The interleaved
+// traversals start from the first level with at least MIN_ROOTS nodes, the levels above it are
+// not timed.
+template <class Allocator, class Node>
+void interleaved_test(const char* name, const Config& config)
+{
+    const size_t MIN_ROOTS = 1024;
+    fprintf(stderr, "-- Testing: %s\n", name);
+    BuiltTree<Allocator, Node> tree(config);
+    auto& root = tree.root;
+    const double n_nodes = g_stat.n_nodes_created;
+    auto t0 = hrclock::now();
+    const int checksum = traverse(root, config.isa);
+    auto t1 = hrclock::now();
+    printf("%-8s %10s %12.2f\n", name, "recursive", n_nodes / 1e6 / ddur(t1 - t0).count());
+
+    int top_checksum = 0;
+    vector<Node*> roots;
+    for (int level = 0; level <= config.tree_depth; ++level) {
+        roots.clear();
+        collect_level(root, level, roots);
+        if (roots.size() >= MIN_ROOTS || level == config.tree_depth) {
+            break;
+        }
+        for (auto node : roots) {
+            top_checksum = (top_checksum + id_checksum(node->node_id)) % 43112609;
+        }
+    }
+    for (int group_size : {1, 2, 4, 8, 16, 32}) {
+        auto t0 = hrclock::now();
+        int subtrees_checksum = traverse_interleaved(roots, group_size);
+        auto t1 = hrclock::now();
+        if ((top_checksum + subtrees_checksum) % 43112609 != checksum) {
+            fprintf(stderr, "Internal error, the interleaved traversal differs.\n");
+            std::terminate();
+        }
+        printf("%-8s %10d %12.2f\n", name, group_size, n_nodes / 1e6 / ddur(t1 - t0).count());
+        fflush(stdout);
+    }
+}
+
+void interleaved(const Config& config)
+{
+    printf("strategy      group     Mnodes/s\n");
+    interleaved_test<without_raii::Allocator, without_raii::Node>("Region", config);
+    interleaved_test<with_raii::Allocator, with_raii::Node>("RAII", config);
+}
+
+// Returns the lowest common ancestor of the nodes with ids a and b in the subtree of node, the one
+// of them found if the other isn't there, or nullptr.
+template <class Node>
+const Node* find_lca(const Node& node, Count a, Count b)
+{
+    if (node.node_id == a || node.node_id == b) {
+        return &node;
+    }
+    const Node* found = nullptr;
+    int n_found = 0;
+    for (auto& c : node.children) {
+        if (const Node* f = find_lca(*c, a, b)) {
+            found = f;
+            ++n_found;
+        }
+    }
+    return n_found == 2 ? &node : found;
+}
+
+// Builds the configured region tree and an euler::Index of it, then answers random subtree
+// checksum, subtree size and LCA queries with the index and by traversing the tree for each query,
+// and prints the throughput to stdout. The nodes of the queries are picked from a random level,
+// so all subtree sizes are asked about, and the traversals answer only a sample of the queries.
+void euler_tour(const Config& config)
+{
+    using Node = without_raii::Node;
+    if (euler::Index::tour_capacity(1 + n_descendants(config.n_children, config.tree_depth)) >
+        (size_t)MAX_NODES) {
+        fprintf(stderr, "The Euler tour of a tree of depth %d is too long for the index.\n",
+                config.tree_depth);
+        return;
+    }
+    BuiltTree<region::Allocator, Node> tree(config);
+    auto& root = tree.root;
+    const Count n_nodes = g_stat.n_nodes_created;
+    vector<vector<Node*>> levels(config.tree_depth + 1);
+    vector<const Node*> by_id(n_nodes);
+    for (int level = 0; level <= config.tree_depth; ++level) {
+        collect_level(root, level, levels[level]);
+        for (auto node : levels[level]) {
+            by_id[node->node_id] = node;
+        }
+    }
+
+    region::Allocator index_allocator(config.region);
+    auto t0 = hrclock::now();
+    euler::Index index(index_allocator, root, 0, n_nodes);
+    auto t1 = hrclock::now();
+    fprintf(stderr, "Index of %lld nodes built in %.3fms: %.3fMB, %.1f bytes/node\n",
+            (long long)n_nodes, ms(t1 - t0), index.bytes() / 1e6,
+            (double)index.bytes() / n_nodes);
+
+    const int n_queries = 1000000, n_traversal_queries = 100;
+    vector<std::pair<Count, Count>> queries(n_queries);
+    std::mt19937 random(12345);
+    auto random_node = [&] {
+        auto& level = levels[random() % levels.size()];
+        return level[random() % level.size()]->node_id;
+    };
+    for (auto& q : queries) {
+        q.first = random_node();
+        q.second = random_node();
+    }
+
+    printf("query             method    queries     queries/s\n");
+    auto row = [&](const char* query, const char* method, int n, auto answer) {
+        long long sum = 0;
+        auto t0 = hrclock::now();
+        for (int i = 0; i < n; ++i) {
+            sum += answer(queries[i].first, queries[i].second);
+        }
+        do_not_optimize(sum);
+        auto t1 = hrclock::now();
+        printf("%-17s %-9s %8d %13.0f\n", query, method, n, n / ddur(t1 - t0).count());
+        fflush(stdout);
+        return sum;
+    };
+    auto subtree_checksum = [&](Count a, Count) { return index.subtree_checksum(a); };
+    auto subtree_size = [&](Count a, Count) { return index.subtree_size(a); };
+    auto lca = [&](Count a, Count b) { return index.lca(a, b); };
+    row("subtree checksum", "index", n_queries, subtree_checksum);
+    long long checksum_sum = row("subtree checksum", "traverse", n_traversal_queries,
+                                 [&](Count a, Count) { return traverse_baseline(*by_id[a]); });
+    row("subtree size", "index", n_queries, subtree_size);
+    long long size_sum = row("subtree size", "traverse", n_traversal_queries,
+                             [&](Count a, Count) { return structure_pass(*by_id[a]); });
+    row("lca", "index", n_queries, lca);
+    long long lca_sum = row("lca", "traverse", n_traversal_queries,
+                            [&](Count a, Count b) { return find_lca(root, a, b)->node_id; });
+
+    // The index answers the sample the same way.
+    for (int i = 0; i < n_traversal_queries; ++i) {
+        checksum_sum -= subtree_checksum(queries[i].first, 0);
+        size_sum -= subtree_size(queries[i].first, 0);
+        lca_sum -= lca(queries[i].first, queries[i].second);
+    }
+    if (checksum_sum || size_sum || lca_sum) {
+        fprintf(stderr, "Internal error, the index doesn't agree with the traversals.\n");
+        std::terminate();
+    }
+}
+
+// Node ids to look up: uniformly random, or Zipf-distributed (the k-th most frequent id is asked
+// about with a probability proportional to 1/k, drawn as n^u - 1 for a uniform u, a continuous
+// approximation), with the ranks scattered over the ids.
+vector<Count> lookup_ids(Count first_id, Count n_nodes, bool zipf, int n)
+{
+    std::mt19937_64 random(12345);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    vector<Count> ids(n);
+    for (auto& id : ids) {
+        if (!zipf) {
+            id = first_id + random() % n_nodes;
+            continue;
+        }
+        uint64_t rank = std::min<double>(std::pow(n_nodes, uniform(random)) - 1, n_nodes - 1);
+        id = first_id + rank * 2654435761u % n_nodes;  // A prime, so this is a permutation.
+    }
+    return ids;
+}
+
+// Builds the configured tree with an IdIndex, then looks up random node ids and reads the node
+// (its child count and the id of its first child), and prints the time per lookup to stdout.
+template <class Allocator, class Node>
+void lookup_test(const char* name, const Config& config)
+{
+    g_stat = AllocationStat{};
+    fprintf(stderr, "-- Testing: %s\n", name);
+    const Count n_nodes = 1 + n_descendants(config.n_children, config.tree_depth);
+    region::Allocator index_allocator(config.region);
+    IdIndex<Node> index(index_allocator, g_stat.n_nodes_created, n_nodes);
+    BuiltTree<Allocator, Node> tree(config, index);
+    auto& root = tree.root;
+    index.add(root);
+    if (std::count(index.nodes, index.nodes + n_nodes, nullptr) != 0) {
+        fprintf(stderr, "Internal error, nodes missing from the index.\n");
+        std::terminate();
+    }
+    for (bool zipf : {false, true}) {
+        vector<Count> ids = lookup_ids(index.first_id, n_nodes, zipf, 1000000);
+        long long sum = 0;
+        auto t0 = hrclock::now();
+        for (Count id : ids) {
+            const Node& node = *index.find(id);
+            auto n = node.children.end() - node.children.begin();
+            sum += n ? n + (*node.children.begin())->node_id : 0;
+        }
+        do_not_optimize(sum);
+        auto t1 = hrclock::now();
+        printf("%-8s %-8s %10.1f %10.3f\n", name, zipf ? "zipf" : "uniform",
+               std::chrono::duration<double, std::nano>(t1 - t0).count() / ids.size(),
+               index.bytes() / 1e6);
+        fflush(stdout);
+    }
+}
+
+// The SoA tree needs no index, the node ids are consecutive, the position of a node is its id
+// minus the first one.
+template <>
+void lookup_test<region::Allocator, soa::Tree>(const char* name, const Config& config)
+{
+    fprintf(stderr, "-- Testing: %s\n", name);
+    BuiltTree<region::Allocator, soa::Tree> built(config);
+    const soa::Tree& tree = built.root;
+    const Count first_id = tree.node_id[0];
+    for (bool zipf : {false, true}) {
+        vector<Count> ids = lookup_ids(first_id, tree.n_nodes, zipf, 1000000);
+        long long sum = 0;
+        auto t0 = hrclock::now();
+        for (Count id : ids) {
+            Count i = id - first_id, n = tree.n_children[i];
+            sum += n ? n + tree.node_id[tree.first_child[i]] : 0;
+        }
+        do_not_optimize(sum);
+        auto t1 = hrclock::now();
+        printf("%-8s %-8s %10.1f %10.3f\n", name, zipf ? "zipf" : "uniform",
+               std::chrono::duration<double, std::nano>(t1 - t0).count() / ids.size(), 0.0);
+        fflush(stdout);
+    }
+}
+
+void lookups(const Config& config)
+{
+    printf("strategy ids       ns/lookup   index_mb\n");
+    lookup_test<without_raii::Allocator, without_raii::Node>("Region", config);
+    lookup_test<with_raii::Allocator, with_raii::Node>("RAII", config);
+    lookup_test<region::Allocator, soa::Tree>("SoA", config);
+}
+
+// A query about the node at the end of a path from the root: the checksum of the ids on the path,
+// or the checksum of the subtree of the node. The path (the child index at each level) is packed
+// into key, so sorting by key puts the queries into the preorder of their nodes.
+struct PathQuery
+{
+    static const int LENGTH_BITS = 6;
+    uint64_t key;  // The child indexes from the highest bits, then the length in LENGTH_BITS.
+    int index;     // Of the answer.
+    bool subtree;
+
+    int length() const { return key & ((1 << LENGTH_BITS) - 1); }
+};
+
+// Packs and unpacks the paths of PathQuery keys, bits_per_level bits per child index.
+struct PathCodec
+{
+    int bits_per_level;
+
+    explicit PathCodec(int n_children) : bits_per_level(1)
+    {
+        while ((1 << bits_per_level) < n_children) {
+            ++bits_per_level;
+        }
+    }
+    bool fits(int depth) const { return depth * bits_per_level <= 64 - PathQuery::LENGTH_BITS; }
+    uint64_t key(const vector<int>& path) const
+    {
+        uint64_t key = 0;
+        for (size_t i = 0; i < path.size(); ++i) {
+            key |= uint64_t(path[i]) << (64 - bits_per_level * (i + 1));
+        }
+        return key | path.size();
+    }
+    int child(uint64_t key, int level) const
+    {
+        return key >> (64 - bits_per_level * (level + 1)) & ((1 << bits_per_level) - 1);
+    }
+};
+
+template <class Node>
+long long answer(const PathQuery& q, const Node& node, int path_checksum)
+{
+    return q.subtree ? traverse_baseline(node) : path_checksum;
+}
+
+// Answers a query, walking from the root.
+template <class Node>
+long long answer_one(const Node& root, const PathCodec& codec, const PathQuery& q)
+{
+    const Node* node = &root;
+    int checksum = id_checksum(root.node_id);
+    for (int level = 0; level < q.length(); ++level) {
+        node = node->children.begin()[codec.child(q.key, level)];
+        checksum = (checksum + id_checksum(node->node_id)) % 43112609;
+    }
+    return answer(q, *node, checksum);
+}
+
+// Answers the queries, which are sorted by key, in tree order: each walk starts from the deepest
+// node of the path of the previous query which is on its path too.
+template <class Node>
+void answer_sorted(const Node& root,
+                   const PathCodec& codec,
+                   const PathQuery* begin,
+                   const PathQuery* end,
+                   long long* answers)
+{
+    vector<const Node*> path{&root};
+    vector<int> checksums{id_checksum(root.node_id)};
+    uint64_t path_key = 0;
+    for (const PathQuery* q = begin; q != end; ++q) {
+        int common = 0;
+        while (common < q->length() && common + 1 < (int)path.size() &&
+               codec.child(q->key, common) == codec.child(path_key, common)) {
+            ++common;
+        }
+        path.resize(common + 1);
+        checksums.resize(common + 1);
+        for (int level = common; level < q->length(); ++level) {
+            path.push_back(path.back()->children.begin()[codec.child(q->key, level)]);
+            checksums.push_back((checksums.back() + id_checksum(path.back()->node_id)) %
+                                43112609);
+        }
+        path_key = q->key;
+        answers[q->index] = answer(*q, *path.back(), checksums.back());
+    }
+}
+
+// Sorts the queries and answers them in tree order. With more than one thread, and enough queries
+// to make starting the threads worth it, the queries about the subtree of each child of the root
+// are a task, and the threads take the tasks in turn.
+template <class Node>
+void answer_batch(const Node& root,
+                  const PathCodec& codec,
+                  PathQuery* begin,
+                  PathQuery* end,
+                  long long* answers,
+                  int n_threads)
+{
+    std::sort(begin, end, [](const PathQuery& a, const PathQuery& b) { return a.key < b.key; });
+    const ptrdiff_t MIN_PARALLEL_BATCH = 10000;
+    if (n_threads == 1 || end - begin < MIN_PARALLEL_BATCH) {
+        answer_sorted(root, codec, begin, end, answers);
+        return;
+    }
+    vector<PathQuery*> tasks{begin};
+    for (PathQuery* q = begin + 1; q != end; ++q) {
+        if (q->length() && codec.child(q->key, 0) != codec.child(q[-1].key, 0)) {
+            tasks.push_back(q);
+        }
+    }
+    tasks.push_back(end);
+    std::atomic<size_t> next_task{0};
+    auto run = [&] {
+        for (size_t t; (t = next_task++) + 1 < tasks.size();) {
+            answer_sorted(root, codec, tasks[t], tasks[t + 1], answers);
+        }
+    };
+    vector<std::thread> threads;
+    for (int t = 1; t < n_threads; ++t) {
+        threads.emplace_back(run);
+    }
+    run();
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+// Builds the configured region tree, makes a million random queries (half of them path, half of
+// them subtree queries, about nodes in the lowest 4 levels, so the subtrees are small) and answers
+// them one at a time and in batches of 1 to 1M queries, on the configured number of threads. Prints
+// the throughput to stdout.
+void batched_queries(const Config& config)
+{
+    using Node = without_raii::Node;
+    const PathCodec codec(config.n_children);
+    if (!codec.fits(config.tree_depth)) {
+        fprintf(stderr, "The paths of a tree of depth %d don't fit into the query keys.\n",
+                config.tree_depth);
+        return;
+    }
+    BuiltTree<region::Allocator, Node> tree(config);
+    auto& root = tree.root;
+
+    const int n_queries = 1000000;
+    vector<PathQuery> queries(n_queries);
+    std::mt19937 random(12345);
+    vector<int> path;
+    for (int i = 0; i < n_queries; ++i) {
+        path.resize(std::max(0, config.tree_depth - (int)(random() % 4)));
+        for (auto& c : path) {
+            c = random() % config.n_children;
+        }
+        queries[i] = PathQuery{codec.key(path), i, random() % 2 == 0};
+    }
+
+    auto t0 = hrclock::now();
+    vector<long long> expected(n_queries);
+    for (auto& q : queries) {
+        expected[q.index] = answer_one(root, codec, q);
+    }
+    auto t1 = hrclock::now();
+    printf("     batch  Mqueries/s\n");
+    printf("%10s %11.3f\n", "unbatched", n_queries / 1e6 / ddur(t1 - t0).count());
+    vector<long long> answers(n_queries);
+    for (int batch = 1; batch <= n_queries; batch *= 10) {
+        vector<PathQuery> batch_queries = queries;
+        auto t0 = hrclock::now();
+        for (int i = 0; i < n_queries; i += batch) {
+            PathQuery* begin = batch_queries.data() + i;
+            PathQuery* end = batch_queries.data() + std::min(n_queries, i + batch);
+            answer_batch(root, codec, begin, end, answers.data(), config.n_threads);
+        }
+        auto t1 = hrclock::now();
+        if (answers != expected) {
+            fprintf(stderr, "Internal error, the batched answers differ.\n");
+            std::terminate();
+        }
+        printf("%10d %11.3f\n", batch, n_queries / 1e6 / ddur(t1 - t0).count());
+        fflush(stdout);
+    }
+}
+
+// Builds the configured tree with the allocators, times full traversals and random root-to-leaf
+// paths and prints the times to stdout.
+template <class Allocator, class Node>
+void depth_regions_row(const char* name,
+                       Allocator& allocator,
+                       vector<unique_ptr<Allocator>>& worker_allocators,
+                       const Config& config)
+{
+    const int n_traversals = 5, n_paths = 1000000;
+    g_stat = AllocationStat{};
+    auto root = build_tree<Allocator, Node>(allocator, worker_allocators, config);
+    const int checksum = traverse(root, config.isa);
+    auto t0 = hrclock::now();
+    for (int i = 0; i < n_traversals; ++i) {
+        if (traverse(root, config.isa) != checksum) {
+            fprintf(stderr, "Internal error, different checksums.\n");
+            std::terminate();
+        }
+    }
+    auto t1 = hrclock::now();
+    long long n_visited = visit_paths(root, n_paths, [](Node& n) -> auto& { return n.children; });
+    do_not_optimize(n_visited);
+    auto t2 = hrclock::now();
+    printf("%-19s %12.3f %10.3f\n", name, ms(t1 - t0) / n_traversals, ms(t2 - t1));
+    fflush(stdout);
+}
+
+// Compares the configured tree in a single region with by_depth regions, with and without huge
+// pages for the top levels, which are those with up to TOP_NODES nodes together.
+void depth_regions(const Config& config)
+{
+    if (config.tree_depth > by_depth::MAX_DEPTH) {
+        fprintf(stderr, "The depth regions support trees of up to %d levels.\n",
+                by_depth::MAX_DEPTH);
+        return;
+    }
+    const Count TOP_NODES = 16384;
+    int top_levels = 1;
+    while (top_levels < config.tree_depth &&
+           1 + n_descendants(config.n_children, top_levels) <= TOP_NODES) {
+        ++top_levels;
+    }
+    fprintf(stderr, "Top levels: %d\n", top_levels);
+    printf("layout              traversal_ms   paths_ms\n");
+    {
+        region::Allocator allocator(config.region);
+        auto worker_allocators =
+            make_worker_allocators<region::Allocator>(config.n_threads, config.region);
+        depth_regions_row<region::Allocator, without_raii::Node>("single region", allocator,
+                                                                 worker_allocators, config);
+    }
+    for (bool huge_pages : {false, true}) {
+        region::Params top_params = config.region;
+        if (huge_pages) {
+            top_params.page_size = std::max(top_params.page_size, region::HUGE_PAGE_SIZE);
+            top_params.huge_pages = true;
+        }
+        by_depth::Allocator allocator(top_params, config.region, top_levels, config.tree_depth);
+        auto worker_allocators = make_worker_allocators<by_depth::Allocator>(
+            config.n_threads, top_params, config.region, top_levels, config.tree_depth);
+        depth_regions_row<by_depth::Allocator, by_depth::Node>(
+            huge_pages ? "by depth, huge top" : "by depth", allocator, worker_allocators, config);
+    }
+}
+
+// Runs the region strategy on trees of increasing depth, up to the configured one, and prints the
+// throughput as the tree outgrows the RAM (with --file-backed, the kernel pages the region in and
+// out of the file).
+void scale(Config config)
+{
+    double ram_mb = 0;
+#if defined(__linux__)
+    ram_mb = sysconf(_SC_PHYS_PAGES) * (double)sysconf(_SC_PAGESIZE) / 1e6;
+#endif
+    fprintf(stderr, "RAM: %.0fMB, region memory: %s\n", ram_mb,
+            config.region.file_directory ? config.region.file_directory : "heap");
+    printf("depth        nodes  memory_mb of_ram build_Mnodes/s traversal_Mnodes/s\n");
+    const int max_depth = config.tree_depth;
+    for (int depth = std::max(1, max_depth - 8); depth <= max_depth; ++depth) {
+        config.tree_depth = depth;
+        auto r = test<without_raii::Allocator, without_raii::Node>("Region", config);
+        double n = r.allocations.n_nodes_created;
+        double mb = r.allocations.total_bytes_allocated / 1e6;
+        auto rate = [n](duration d) { return n / 1e6 / ddur(d).count(); };
+        printf("%5d %12.0f %10.0f %5.0f%% %14.2f %18.2f\n", depth, n, mb,
+               ram_mb ? 100 * mb / ram_mb : 0.0, rate(r.build), rate(r.traversal));
+        fflush(stdout);
+    }
+}
+
+const char* const USAGE =
+    "Usage: %s [OPTIONS]\n"
+    "\n"
+    "Options:\n"
+    "  --trace[=FILE]        Write a Chrome trace-event timeline (default: trace.json).\n"
+    "  --depth=N             Tree depth (default: %d).\n"
+    "  --children=N          Children per node (default: %d).\n"
+    "  --page-size=N         Page size of the region allocator in bytes (default: %d).\n"
+    "  --small-block-size=N  Bigger blocks bypass the pages of the region (default: %d).\n"
+    "  --threads=N           Number of threads building the tree (default: 1).\n"
+    "  --isa=NAME            Instruction set of the traversal: baseline, x86-64-v3 or x86-64-v4\n"
+    "                        (default: the best one the CPU supports).\n"
+    "  --sweep               Run a grid of configurations and print per-node costs to stdout.\n"
+    "  --depths=N,N,...      Depths of the sweep.\n"
+    "  --fanouts=N,N,...     Children per node of the sweep.\n"
+    "  --page-sizes=N,N,...  Page sizes of the sweep.\n"
+    "  --thread-counts=N,... Thread counts of the sweep.\n"
+    "  --mem-limit=MB        Skip sweep trees needing more memory (default: half of the RAM).\n"
+    "  --csv                 Print the sweep results as CSV.\n"
+    "  --autotune            Find the best page size and small block threshold for the tree.\n"
+    "  --small-block-sizes=N,N,...\n"
+    "                        Small block thresholds tried by --autotune.\n"
+    "  --repetitions=N       Runs of each --autotune candidate, the best counts (default: 3).\n"
+    "  --strategies=NAME,... Strategies to compare, or `all` (default: region,raii). One of:\n"
+    "                        %s.\n"
+    "  --report=NAME         Run a single strategy and print its raw results to stdout.\n"
+    "  --lazy-paths=K        Visit K random root-to-leaf paths of a tree built eagerly and of one\n"
+    "                        built on demand.\n"
+    "  --incremental[=N,N,...]\n"
+    "                        Change the ids of batches of N random nodes, compare recomputing the\n"
+    "                        checksum fully and from cached subtree checksums.\n"
+    "  --diff                Compare rebuilding a slightly changed tree with diffing and patching\n"
+    "                        the old one.\n"
+    "  --file-backed=DIR     Map the region memory from a temporary file in DIR.\n"
+    "  --scale               Print the throughput of the region strategy for the depths up to\n"
+    "                        --depth, as the tree outgrows the RAM.\n"
+    "  --freeze              Compare freezing the tree into a CSR snapshot with the traversal\n"
+    "                        time it saves.\n"
+    "  --cold-subtrees[=N]   Pack the subtrees of N levels (default: 6) into byte streams,\n"
+    "                        expanded when first visited, and run skewed path queries.\n"
+    "  --fused               Compare running 1 to 4 visitors in separate passes and fused into\n"
+    "                        one.\n"
+    "  --interleaved         Print the nodes/s of traversals interleaving 1 to 32 cursors with\n"
+    "                        prefetching.\n"
+    "  --euler               Compare subtree and lowest common ancestor queries answered by an\n"
+    "                        Euler-tour index and by traversing the tree.\n"
+    "  --lookups             Print the time of looking up nodes by uniform and Zipf-distributed\n"
+    "                        random ids, through an id index or the SoA arrays.\n"
+    "  --batched             Compare answering random path and subtree queries one at a time\n"
+    "                        and sorted into tree order in batches, on --threads threads.\n"
+    "  --depth-regions       Compare traversals of a tree in a single region and in separate\n"
+    "                        regions for the top levels, the other inner nodes and the leaves.\n";
+
+int main(int argc, char* argv[])
+{
+    const char* trace_path = nullptr;
+    Config config;
+    Grid grid;
+    bool run_sweep = false, run_autotune = false;
+    int n_lazy_paths = 0;
+    vector<long long> incremental_batches;
+    bool run_diff = false, run_scale = false, run_freeze = false;
+    int cold_levels = 0;
+    bool run_fused = false, run_interleaved = false, run_euler = false, run_lookups = false;
+    bool run_batched = false, run_depth_regions = false;
+    vector<const Strategy*> strategies{&STRATEGIES[0], &STRATEGIES[1]};
+    const Strategy* report_strategy = nullptr;
+    std::string strategy_names;
+    for (auto& s : STRATEGIES) {
+        if (s.available()) {
+            strategy_names += (strategy_names.empty() ? "" : ", ") + std::string(s.name);
+        }
+    }
+    auto usage = [&] {
+        fprintf(stderr, USAGE, argv[0], TREE_DEPTH, N_CHILDREN, region::PAGE_SIZE,
+                region::MAX_SMALL_BLOCK_SIZE, strategy_names.c_str());
+        return EXIT_FAILURE;
+    };
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = nullptr;
+        vector<long long> list;
+        bool ok = true;
+        if (strcmp(arg, "--trace") == 0) {
+            trace_path = "trace.json";
+        } else if (match_option(arg, "--trace", value)) {
+            trace_path = value;
+        } else if (match_option(arg, "--depth", value)) {
+            ok = parse_list(value, list) && list.size() == 1;
+            config.tree_depth = ok ? list[0] : 0;
+        } else if (match_option(arg, "--children", value)) {
+            ok = parse_list(value, list) && list.size() == 1;
+            config.n_children = ok ? list[0] : 0;
+        } else if (match_option(arg, "--page-size", value)) {
+            ok = parse_list(value, list) && list.size() == 1;
+            config.region.page_size = ok ? list[0] : 0;
+        } else if (match_option(arg, "--small-block-size", value)) {
+            ok = parse_list(value, list) && list.size() == 1;
+            config.region.max_small_block_size = ok ? list[0] : 0;
+        } else if (match_option(arg, "--threads", value)) {
+            ok = parse_list(value, list) && list.size() == 1;
+            config.n_threads = ok ? list[0] : 0;
+        } else if (match_option(arg, "--isa", value)) {
+            ok = false;
+            for (Isa isa : {Isa::BASELINE, Isa::X86_64_V3, Isa::X86_64_V4}) {
+                if (strcmp(value, ISA_NAMES[(int)isa]) == 0 && isa_supported(isa)) {
+                    config.isa = isa;
+                    ok = true;
+                }
+            }
+        } else if (strcmp(arg, "--sweep") == 0) {
+            run_sweep = true;
+        } else if (match_option(arg, "--depths", value)) {
+            ok = parse_list(value, grid.depths);
+        } else if (match_option(arg, "--fanouts", value)) {
+            ok = parse_list(value, grid.fanouts);
+        } else if (match_option(arg, "--page-sizes", value)) {
+            ok = parse_list(value, grid.page_sizes);
+            for (auto x : grid.page_sizes) {
+                ok = ok && x >= region::MAX_SMALL_BLOCK_SIZE;
+            }
+        } else if (match_option(arg, "--thread-counts", value)) {
+            ok = parse_list(value, grid.thread_counts);
+        } else if (match_option(arg, "--mem-limit", value)) {
+            ok = parse_list(value, list) && list.size() == 1;
+            grid.mem_limit_mb = ok ? list[0] : 0;
+        } else if (strcmp(arg, "--csv") == 0) {
+            grid.csv = true;
+        } else if (strcmp(arg, "--autotune") == 0) {
+            run_autotune = true;
+        } else if (match_option(arg, "--small-block-sizes", value)) {
+            ok = parse_list(value, grid.small_block_sizes);
+        } else if (match_option(arg, "--repetitions", value)) {
+            ok = parse_list(value, list) && list.size() == 1;
+            grid.repetitions = ok ? list[0] : 0;
+        } else if (match_option(arg, "--strategies", value)) {
+            ok = parse_strategies(value, strategies);
+        } else if (strcmp(arg, "--diff") == 0) {
+            run_diff = true;
+        } else if (match_option(arg, "--file-backed", value)) {
+            config.region.file_directory = value;
+            config.region.on_heap_allocation = count_mapped_allocation;
+        } else if (strcmp(arg, "--cold-subtrees") == 0) {
+            cold_levels = 6;
+        } else if (match_option(arg, "--cold-subtrees", value)) {
+            ok = parse_list(value, list) && list.size() == 1 && list[0] > 0;
+            cold_levels = ok ? list[0] : 0;
+        } else if (strcmp(arg, "--fused") == 0) {
+            run_fused = true;
+        } else if (strcmp(arg, "--interleaved") == 0) {
+            run_interleaved = true;
+        } else if (strcmp(arg, "--euler") == 0) {
+            run_euler = true;
+        } else if (strcmp(arg, "--lookups") == 0) {
+            run_lookups = true;
+        } else if (strcmp(arg, "--batched") == 0) {
+            run_batched = true;
+        } else if (strcmp(arg, "--depth-regions") == 0) {
+            run_depth_regions = true;
+        } else if (strcmp(arg, "--freeze") == 0) {
+            run_freeze = true;
+        } else if (strcmp(arg, "--scale") == 0) {
+            run_scale = true;
+        } else if (strcmp(arg, "--incremental") == 0) {
+            incremental_batches = {1, 10, 100, 1000, 10000, 100000};
+        } else if (match_option(arg, "--incremental", value)) {
+            ok = parse_list(value, incremental_batches);
+        } else if (match_option(arg, "--lazy-paths", value)) {
+            ok = parse_list(value, list) && list.size() == 1;
+            n_lazy_paths = ok ? list[0] : 0;
+        } else if (match_option(arg, "--report", value)) {
+            report_strategy = find_strategy(value, strlen(value));
+            ok = report_strategy != nullptr;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            return usage();
+        }
+    }
+    if (!config.region.valid()) {
+        return usage();
+    }
+    double n_nodes = 1, level_size = 1;
+    for (int i = 0; i < config.tree_depth; ++i) {
+        level_size *= config.n_children;
+        n_nodes += level_size;
+    }
+    if (n_nodes > MAX_NODES && !n_lazy_paths) {
+        fprintf(stderr, "A tree of %.0f nodes needs 64-bit node ids (benchmark-scale).\n",
+                n_nodes);
+        return EXIT_FAILURE;
+    }
+    if (trace_path && !g_trace.open(trace_path)) {
+        fprintf(stderr, "Can't open %s for writing.\n", trace_path);
+        return EXIT_FAILURE;
+    }
+
+    if (report_strategy) {
+        print_raw_report(report_strategy->run(report_strategy->title, config));
+    } else if (run_sweep) {
+        sweep(grid);
+    } else if (run_autotune) {
+        autotune(config, grid);
+    } else if (n_lazy_paths) {
+        lazy_paths(config, grid, n_lazy_paths);
+    } else if (!incremental_batches.empty()) {
+        incremental(config, incremental_batches);
+    } else if (run_diff) {
+        diff_patch(config);
+    } else if (run_scale) {
+        scale(config);
+    } else if (run_freeze) {
+        freeze_benchmark(config);
+    } else if (cold_levels) {
+        cold_subtrees(config, cold_levels);
+    } else if (run_fused) {
+        fused(config);
+    } else if (run_interleaved) {
+        interleaved(config);
+    } else if (run_euler) {
+        euler_tour(config);
+    } else if (run_lookups) {
+        lookups(config);
+    } else if (run_batched) {
+        batched_queries(config);
+    } else if (run_depth_regions) {
+        depth_regions(config);
+    } else {
+        compare(strategies, config);
+    }
+
+    if (g_trace.enabled()) {
+        g_trace.close();
+        fprintf(stderr, "\nTrace written to %s\n", trace_path);
+    }
 }
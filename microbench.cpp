@@ -0,0 +1,289 @@
+// Micro-benchmarks of the allocation primitives alone, without the tree: region::Allocator's
+// allocate_block() against malloc, the std::pmr memory resources and a fixed-size object pool, on
+// fixed and mixed block sizes, alignments from 1 to 64 and page-rollover-heavy patterns.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "do_not_optimize.h"
+#include "perf_counters.h"
+#include "region/allocator.h"
+
+using std::vector;
+using std::pmr::monotonic_buffer_resource;
+using std::pmr::synchronized_pool_resource;
+using std::pmr::unsynchronized_pool_resource;
+
+using hrclock = std::chrono::high_resolution_clock;
+using duration = hrclock::duration;
+
+// A sequence of allocation requests.
+struct Pattern
+{
+    std::string name;
+    vector<size_t> sizes;
+    vector<size_t> alignments;
+    region::Params params;  // Region allocator parameters for this pattern.
+
+    // The object pool can serve only a single size and alignment.
+    bool fixed_block() const
+    {
+        return std::all_of(sizes.begin(), sizes.end(), [&](size_t s) { return s == sizes[0]; }) &&
+               std::all_of(alignments.begin(), alignments.end(),
+                           [&](size_t a) { return a == alignments[0]; });
+    }
+};
+
+// Fixed-size object pool: bump-allocates blocks from 64K chunks and keeps freed blocks on a free
+// list for reuse.
+class ObjectPool
+{
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    const size_t block_size;
+    vector<char*> chunks;
+    FreeBlock* free_list = nullptr;
+    char* chunk_next = nullptr;
+    char* chunk_end = nullptr;
+
+public:
+    ObjectPool(size_t size, size_t alignment)
+        : block_size((std::max(size, sizeof(FreeBlock)) + alignment - 1) / alignment * alignment)
+    {}
+    ~ObjectPool()
+    {
+        for (auto c : chunks) {
+            free(c);
+        }
+    }
+
+    void* allocate(size_t alignment)
+    {
+        if (free_list) {
+            void* p = free_list;
+            free_list = free_list->next;
+            return p;
+        }
+        if (chunk_next == chunk_end) {
+            size_t chunk_size = 65536 / block_size * block_size;
+            chunks.push_back((char*)aligned_alloc(std::max(alignment, sizeof(void*)), chunk_size));
+            chunk_next = chunks.back();
+            chunk_end = chunk_next + chunk_size;
+        }
+        void* p = chunk_next;
+        chunk_next += block_size;
+        return p;
+    }
+    void deallocate(void* p)
+    {
+        auto b = (FreeBlock*)p;
+        b->next = free_list;
+        free_list = b;
+    }
+};
+
+// The allocators under test. allocate() is timed, release() is not.
+
+struct RegionAllocator
+{
+    region::Allocator allocator;
+
+    explicit RegionAllocator(const Pattern& p) : allocator(p.params) {}
+    void* allocate(size_t size, size_t alignment)
+    {
+        return allocator.allocate_block(size, alignment);
+    }
+    void release(vector<void*>&) {}
+};
+
+struct MallocAllocator
+{
+    explicit MallocAllocator(const Pattern&) {}
+    void* allocate(size_t size, size_t alignment)
+    {
+        // malloc's alignment is good enough up to alignof(max_align_t).
+        if (alignment <= alignof(max_align_t)) {
+            return malloc(size);
+        }
+        return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+    void release(vector<void*>& blocks)
+    {
+        for (auto p : blocks) {
+            free(p);
+        }
+    }
+};
+
+template <class Resource>
+struct PmrAllocator
+{
+    Resource resource;
+    const Pattern& pattern;
+
+    explicit PmrAllocator(const Pattern& p) : pattern(p) {}
+    void* allocate(size_t size, size_t alignment) { return resource.allocate(size, alignment); }
+    void release(vector<void*>& blocks)
+    {
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            resource.deallocate(blocks[i], pattern.sizes[i], pattern.alignments[i]);
+        }
+    }
+};
+
+struct PoolAllocator
+{
+    ObjectPool pool;
+
+    explicit PoolAllocator(const Pattern& p) : pool(p.sizes[0], p.alignments[0]) {}
+    void* allocate(size_t, size_t alignment) { return pool.allocate(alignment); }
+    void release(vector<void*>& blocks)
+    {
+        for (auto p : blocks) {
+            pool.deallocate(p);
+        }
+    }
+};
+
+struct Result
+{
+    double ns_per_op;
+    double instructions_per_op;  // Negative if not available.
+};
+
+// Runs the pattern with a new Allocator `repetitions` times, returns the fastest run. With touch,
+// the first byte of each block is written, so the cost of faulting in fresh memory is included.
+template <class Allocator>
+Result run(const Pattern& pattern, int repetitions, bool touch)
+{
+    const size_t n = pattern.sizes.size();
+    vector<void*> blocks(n);
+    PerfCounter instructions(PerfCounter::INSTRUCTIONS);
+    Result best{0, -1};
+    for (int r = 0; r < repetitions; ++r) {
+        Allocator allocator(pattern);
+        const size_t* sizes = pattern.sizes.data();
+        const size_t* alignments = pattern.alignments.data();
+        instructions.start();
+        auto t0 = hrclock::now();
+        for (size_t i = 0; i < n; ++i) {
+            void* p = allocator.allocate(sizes[i], alignments[i]);
+            if (touch) {
+                *(char*)p = 0;
+            }
+            do_not_optimize(p);
+            blocks[i] = p;
+        }
+        auto t1 = hrclock::now();
+        instructions.stop();
+        allocator.release(blocks);
+
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+        if (r == 0 || ns < best.ns_per_op) {
+            best.ns_per_op = ns;
+            best.instructions_per_op =
+                instructions.available() ? (double)instructions.value() / n : -1;
+        }
+    }
+    return best;
+}
+
+vector<Pattern> make_patterns(size_t n_ops)
+{
+    vector<Pattern> patterns;
+    std::mt19937 random(12345);
+    auto add = [&](std::string name, auto size, auto alignment) {
+        Pattern p;
+        p.name = name;
+        for (size_t i = 0; i < n_ops; ++i) {
+            p.sizes.push_back(size());
+            p.alignments.push_back(alignment());
+        }
+        patterns.push_back(p);
+        return &patterns.back();
+    };
+    auto constant = [](size_t x) { return [x] { return x; }; };
+    auto log_uniform = [&](int min_log2, int max_log2) {
+        return [&random, min_log2, max_log2] {
+            return size_t(1) << std::uniform_int_distribution<int>(min_log2, max_log2)(random);
+        };
+    };
+
+    for (size_t size : {8, 24, 64, 256}) {
+        add("fixed " + std::to_string(size), constant(size), constant(8));
+    }
+    add("mixed 8-512", [&] { return std::uniform_int_distribution<size_t>(8, 512)(random); },
+        constant(8));
+    for (size_t alignment : {1, 2, 4, 8, 16, 32, 64}) {
+        add("24, align " + std::to_string(alignment), constant(24), constant(alignment));
+    }
+    add("mixed 8-512, align 1-64",
+        [&] { return std::uniform_int_distribution<size_t>(8, 512)(random); }, log_uniform(0, 6));
+    // Every 16th allocation needs a new page.
+    add("rollover 4096/65536", constant(4096), constant(8));
+    // Each allocation needs a new page and abandons almost half of the previous one.
+    auto p = add("rollover 2049/4096", constant(2049), constant(8));
+    p->params.page_size = 4096;
+    p->params.max_small_block_size = 4096;
+    return patterns;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n_ops = 1 << 18;
+    int repetitions = 5;
+    bool touch = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--ops=", 6) == 0 && atoi(argv[i] + 6) > 0) {
+            n_ops = atoi(argv[i] + 6);
+        } else if (strncmp(argv[i], "--repetitions=", 14) == 0 && atoi(argv[i] + 14) > 0) {
+            repetitions = atoi(argv[i] + 14);
+        } else if (strcmp(argv[i], "--touch") == 0) {
+            touch = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--ops=N] [--repetitions=N] [--touch]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    fprintf(stderr,
+            "Allocating %zu blocks per run, best of %d runs. Only the allocation is timed, "
+            "freeing is not.%s\n",
+            n_ops, repetitions, touch ? " The first byte of each block is written." : "");
+    if (!PerfCounter(PerfCounter::INSTRUCTIONS).available()) {
+        fprintf(stderr, "Instruction counter not available (see perf_event_paranoid).\n");
+    }
+    printf("\n%-24s %-16s %8s %9s\n", "pattern", "allocator", "ns/op", "instr/op");
+    for (auto& pattern : make_patterns(n_ops)) {
+        auto print = [&](const char* allocator, Result r) {
+            printf("%-24s %-16s %8.2f ", pattern.name.c_str(), allocator, r.ns_per_op);
+            if (r.instructions_per_op >= 0) {
+                printf("%9.1f\n", r.instructions_per_op);
+            } else {
+                printf("%9s\n", "n/a");
+            }
+            fflush(stdout);
+        };
+        print("region", run<RegionAllocator>(pattern, repetitions, touch));
+        print("malloc", run<MallocAllocator>(pattern, repetitions, touch));
+        print("pmr monotonic",
+              run<PmrAllocator<monotonic_buffer_resource>>(pattern, repetitions, touch));
+        print("pmr pool",
+              run<PmrAllocator<unsynchronized_pool_resource>>(pattern, repetitions, touch));
+        print("pmr sync pool",
+              run<PmrAllocator<synchronized_pool_resource>>(pattern, repetitions, touch));
+        if (pattern.fixed_block()) {
+            print("object pool", run<PoolAllocator>(pattern, repetitions, touch));
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Counts a hardware event (instructions, cache misses, ...) of the calling thread in user space,
+// with perf_event_open(). On other systems, or if the kernel doesn't allow it (see
+// /proc/sys/kernel/perf_event_paranoid) or there is no PMU (most virtual machines), available()
+// is false and value() is -1.
+class PerfCounter
+{
+    int fd = -1;
+
+public:
+#if defined(__linux__)
+    enum Event : uint64_t
+    {
+        INSTRUCTIONS = PERF_COUNT_HW_INSTRUCTIONS,
+        CACHE_MISSES = PERF_COUNT_HW_CACHE_MISSES,
+        BRANCH_MISSES = PERF_COUNT_HW_BRANCH_MISSES,
+    };
+
+    explicit PerfCounter(Event event)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = event;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~PerfCounter()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    void start()
+    {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    void stop()
+    {
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    long long value() const
+    {
+        long long count;
+        if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count))
+            return -1;
+        return count;
+    }
+#else
+    enum Event : uint64_t
+    {
+        INSTRUCTIONS,
+        CACHE_MISSES,
+        BRANCH_MISSES,
+    };
+
+    explicit PerfCounter(Event) {}
+    void start() {}
+    void stop() {}
+    long long value() const { return -1; }
+#endif
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+    bool available() const { return fd >= 0; }
+};
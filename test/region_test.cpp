@@ -0,0 +1,223 @@
+// Unit tests of the region library.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "region/adapters.h"
+#include "region/allocator.h"
+#include "region/vector.h"
+
+// Like assert() but also checked in release builds.
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        if (!(condition)) {                                                                \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            exit(EXIT_FAILURE);                                                            \
+        }                                                                                  \
+    } while (false)
+
+bool is_aligned(const void* p, size_t alignment)
+{
+    return (uintptr_t)p % alignment == 0;
+}
+
+void test_alignment()
+{
+    region::Allocator a;
+    char* previous_end = nullptr;
+    for (int i = 0; i < 1000; ++i) {
+        size_t size = 1 + i % 37;
+        size_t alignment = size_t(1) << (i % 7);  // 1..64
+        char* p = (char*)a.allocate_block(size, alignment);
+        CHECK(p);
+        CHECK(is_aligned(p, alignment));
+        // Blocks from the same page follow each other, padded only for the alignment.
+        if (previous_end && p >= previous_end && p < previous_end + 4096) {
+            CHECK(p - previous_end < (ptrdiff_t)alignment);
+        }
+        previous_end = p + size;
+    }
+    CHECK(a.n_pages() == 1);
+    CHECK(a.n_large_blocks() == 0);
+
+    struct alignas(64) CacheLine
+    {
+        char x;
+    };
+    auto c = a.new_object<CacheLine>();
+    CHECK(is_aligned(c, 64));
+}
+
+void test_page_rollover()
+{
+    region::Params params;
+    params.page_size = 4096;
+    params.max_small_block_size = 1024;
+    region::Allocator a(params);
+
+    char* first = (char*)a.allocate_block(1000, 8);
+    char* second = (char*)a.allocate_block(1000, 8);
+    char* third = (char*)a.allocate_block(1000, 8);
+    char* fourth = (char*)a.allocate_block(1000, 8);
+    CHECK(a.n_pages() == 1);
+    CHECK(second == first + 1000 && third == second + 1000 && fourth == third + 1000);
+
+    // Doesn't fit into the 96 bytes left, goes to a new page.
+    char* fifth = (char*)a.allocate_block(100, 8);
+    CHECK(a.n_pages() == 2);
+    CHECK(fifth < first || fifth >= first + 4096);
+    // The rest of the old page is not used any more.
+    char* sixth = (char*)a.allocate_block(8, 8);
+    CHECK(sixth == fifth + 104);
+    CHECK(a.n_pages() == 2);
+
+    // A block of exactly max_small_block_size still comes from a page.
+    for (int i = 0; i < 10; ++i) {
+        a.allocate_block(1024, 1);
+    }
+    CHECK(a.n_large_blocks() == 0);
+    CHECK(a.n_pages() > 2);
+
+    std::vector<int> heap_allocation_sizes;
+    static std::vector<int>* sizes = &heap_allocation_sizes;
+    params.on_heap_allocation = [](bool large_block, size_t bytes, region::Params::time_point) {
+        sizes->push_back(large_block ? -(int)bytes : (int)bytes);
+    };
+    region::Allocator b(params);
+    for (int i = 0; i < 9; ++i) {
+        b.allocate_block(1024, 8);
+    }
+    CHECK(heap_allocation_sizes == (std::vector<int>{4096, 4096, 4096}));
+}
+
+void test_large_blocks()
+{
+    region::Params params;
+    params.page_size = 4096;
+    params.max_small_block_size = 1024;
+    region::Allocator a(params);
+
+    char* small = (char*)a.allocate_block(16, 8);
+    CHECK(a.n_pages() == 1);
+    char* large = (char*)a.allocate_block(100000, 64);
+    CHECK(large);
+    CHECK(is_aligned(large, 64));
+    CHECK(a.n_large_blocks() == 1);
+    CHECK(a.n_pages() == 1);
+    // The whole block is writable.
+    for (int i = 0; i < 100000; ++i) {
+        large[i] = (char)i;
+    }
+    // The active page is not abandoned by a large block.
+    CHECK((char*)a.allocate_block(16, 8) == small + 16);
+
+    // Small enough, but with the alignment it might not fit into an empty page.
+    char* overaligned = (char*)a.allocate_block(1024, 4096);
+    CHECK(is_aligned(overaligned, 4096));
+    CHECK(a.n_large_blocks() == 2);
+}
+
+void test_arrays()
+{
+    region::Allocator a;
+    double* small = a.new_array<double>(100);
+    CHECK(is_aligned(small, alignof(double)));
+    CHECK(a.n_pages() == 1);
+    int* large = a.new_array<int>(100000);
+    CHECK(a.n_large_blocks() == 1);
+    for (int i = 0; i < 100000; ++i) {
+        large[i] = i;
+    }
+    CHECK(large[99999] == 99999);
+}
+
+void test_file_backed()
+{
+    region::Params params;
+    params.page_size = 4096;
+    params.max_small_block_size = 1024;
+    params.file_directory = "/tmp";
+    region::Allocator a(params);
+    char* first = nullptr;
+    for (int i = 0; i < 10000; ++i) {
+        char* p = (char*)a.allocate_block(1000, 8);
+        CHECK(is_aligned(p, 8));
+        memset(p, i, 1000);
+        first = first ? first : p;
+    }
+    CHECK(a.n_pages() == 2500);
+    CHECK(first[999] == 0);
+    int* large = a.new_array<int>(1000000);
+    CHECK(is_aligned(large, alignof(int)));
+    CHECK(a.n_large_blocks() == 1);
+    large[999999] = 42;
+    CHECK(large[999999] == 42);
+}
+
+void test_huge_pages()
+{
+    region::Params params;
+    params.page_size = region::HUGE_PAGE_SIZE;
+    params.huge_pages = true;
+    region::Allocator a(params);
+    // The first block of each page is at its start.
+    for (size_t n_pages = 0; n_pages < 3;) {
+        char* p = (char*)a.allocate_block(params.max_small_block_size, 8);
+        if (a.n_pages() != n_pages) {
+            CHECK(is_aligned(p, region::HUGE_PAGE_SIZE));
+            n_pages = a.n_pages();
+        }
+        memset(p, 1, params.max_small_block_size);
+    }
+}
+
+void test_vector()
+{
+    region::Allocator a;
+    region::Vector<double> v(a, 3);
+    CHECK(v.begin() == v.end());
+    v.push_back(1);
+    v.push_back(2);
+    v.push_back(3);
+    CHECK(v.end() - v.begin() == 3);
+    CHECK(v.begin()[0] == 1 && v.begin()[2] == 3);
+    CHECK(is_aligned(v.begin(), alignof(double)));
+}
+
+void test_adapters()
+{
+    region::Allocator a;
+    std::vector<int, region::StdAllocator<int>> v{region::StdAllocator<int>(a)};
+    for (int i = 0; i < 10000; ++i) {
+        v.push_back(i);
+    }
+    CHECK(v[9999] == 9999);
+    CHECK(a.n_pages() + a.n_large_blocks() > 0);
+    CHECK(v.get_allocator() == region::StdAllocator<long>(a));
+    region::Allocator b;
+    CHECK(v.get_allocator() != region::StdAllocator<int>(b));
+
+    region::Allocator c;
+    region::MemoryResource resource(c);
+    std::pmr::vector<std::pmr::vector<int>> w(&resource);
+    w.resize(10);
+    w[3].push_back(42);
+    CHECK(w[3][0] == 42);
+    CHECK(c.n_pages() == 1);
+}
+
+int main()
+{
+    test_alignment();
+    test_page_rollover();
+    test_large_blocks();
+    test_arrays();
+    test_file_backed();
+    test_huge_pages();
+    test_vector();
+    test_adapters();
+    fprintf(stderr, "All tests passed.\n");
+}